@@ -29,6 +29,12 @@ const int SHARED_PARAMETER_SIZE = 5000;
 // use straightforward calculation for FM2 matrix
 #define SIMPLE_FM2                                 0
 
+// use batched, vectorizable log-sum-exp for the FM2 matrix in the
+// inside and outside algorithms (usually set by the build system)
+#ifndef SIMD_FM2
+#define SIMD_FM2                                   0
+#endif
+
 // use candidate list optimization for Viterbi parsing
 #define CANDIDATE_LIST                             1
 
@@ -73,6 +73,9 @@ class InferenceEngine
     std::vector<RealT> FCj, F5j, FMj, FM1j;          // inside2
     std::vector<RealT> FCo, F5o, FMo, FM1o;          // outside
     std::vector<RealT> FCp, F5p, FMp, FM1p;          // outside2
+#if SIMD_FM2
+    std::vector<RealT> FM2buf;                       // scratch for batched FM2 sums
+#endif
     
 #if PARAMS_HELIX_LENGTH || PARAMS_ISOLATED_BASE_PAIR
     std::vector<int> FEt, FNt;
@@ -3367,6 +3367,9 @@ void InferenceEngine<RealT>::ComputeInside()
     FCi.clear(); FCi.resize(SIZE, RealT(NEG_INF));
     FMi.clear(); FMi.resize(SIZE, RealT(NEG_INF));
     FM1i.clear(); FM1i.resize(SIZE, RealT(NEG_INF));
+#if SIMD_FM2
+    FM2buf.resize(L+1);
+#endif
     
 #if PARAMS_HELIX_LENGTH || PARAMS_ISOLATED_BASE_PAIR
     FEi.clear(); FEi.resize(SIZE, RealT(NEG_INF));
@@ -3388,6 +3391,20 @@ void InferenceEngine<RealT>::ComputeInside()
             for (int k = i+1; k < j; k++)
                 Fast_LogPlusEquals(FM2i, FM1i[offset[i]+k] + FMi[offset[k]+j]);
             
+#elif SIMD_FM2
+
+            // gather the terms into a contiguous buffer, then reduce
+            // them with a single batched log-sum-exp
+            
+            if (i+2 <= j)
+            {
+                const RealT *p1 = &(FM1i[offset[i]+i+1]);
+                RealT *buf = &(FM2buf[0]);
+                for (int k = i+1; k < j; k++)
+                    *buf++ = *p1++ + FMi[offset[k]+j];
+                FM2i = Fast_LogSumExp(&(FM2buf[0]), j-i-1);
+            }
+            
 #else
             if (max_bp_dist==0)
             {
@@ -4152,6 +4169,9 @@ void InferenceEngine<RealT>::ComputeOutside()
     FCo.clear(); FCo.resize(SIZE, RealT(NEG_INF));
     FMo.clear(); FMo.resize(SIZE, RealT(NEG_INF));
     FM1o.clear(); FM1o.resize(SIZE, RealT(NEG_INF));
+#if SIMD_FM2
+    FM2buf.resize(L+1);
+#endif
     
 #if PARAMS_HELIX_LENGTH || PARAMS_ISOLATED_BASE_PAIR
     FEo.clear(); FEo.resize(SIZE, RealT(NEG_INF));
@@ -4452,6 +4472,22 @@ void InferenceEngine<RealT>::ComputeOutside()
                 Fast_LogPlusEquals(FMo[offset[k]+j], FM2o + FM1i[offset[i]+k]);
             }
 
+#elif SIMD_FM2
+
+            // FM1o[i,k] is contiguous in k and is updated in a single
+            // vectorized pass; FMo[k,j] is strided and stays scalar
+            
+            if (i+2 <= j)
+            {
+                RealT *buf = &(FM2buf[0]);
+                for (int k = i+1; k < j; k++)
+                {
+                    *buf++ = FMi[offset[k]+j];
+                    Fast_LogPlusEquals(FMo[offset[k]+j], FM2o + FM1i[offset[i]+k]);
+                }
+                Fast_LogPlusEqualsArray(&(FM1o[offset[i]+i+1]), &(FM2buf[0]), FM2o, j-i-1);
+            }
+            
 #else
             if (max_bp_dist==0)
             {
@@ -243,6 +243,111 @@ inline void Fast_LogPlusEquals (float &x, float y)
         x = Fast_LogExpPlusOne(x-y) + y;
 }
 
+//////////////////////////////////////////////////////////////////////
+// Vec_Exp()
+// Vec_LogExpPlusOne()
+//
+// Branch-free approximations for use inside vectorized loops.
+// Vec_Exp() assumes x <= 0 and uses a range reduction to [-ln2/2,
+// ln2/2] with a degree-6 Taylor polynomial; Vec_LogExpPlusOne()
+// assumes x <= 0 and evaluates log1p(exp(x)) via the atanh series.
+// Both are accurate to about 2e-07, well within the tolerance of
+// Fast_LogExpPlusOne().
+//////////////////////////////////////////////////////////////////////
+
+inline float Vec_Exp(float x)
+{
+    x = x < float(-87.0) ? float(-87.0) : x;
+    const int ni = static_cast<int>(x * float(1.4426950409) - float(0.5));
+    const float n = static_cast<float>(ni);
+    const float r = (x - n * float(0.6933593750)) + n * float(2.1219444e-4);
+    float p = float(1.0/720);
+    p = p * r + float(1.0/120);
+    p = p * r + float(1.0/24);
+    p = p * r + float(1.0/6);
+    p = p * r + float(0.5);
+    p = p * r + float(1.0);
+    p = p * r + float(1.0);
+    const int bits = (ni + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+inline float Vec_LogExpPlusOne(float x)
+{
+    const float t = Vec_Exp(x);
+    const float u = t / (float(2) + t);
+    const float u2 = u * u;
+    float p = float(1.0/11);
+    p = p * u2 + float(1.0/9);
+    p = p * u2 + float(1.0/7);
+    p = p * u2 + float(1.0/5);
+    p = p * u2 + float(1.0/3);
+    p = p * u2 + float(1.0);
+    return float(2) * u * p;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Fast_LogSumExp()
+//
+// Compute log(SUM (0<=k<n : exp(x[k]))) in two passes: find the
+// maximum, then accumulate the shifted exponentials.  In contrast to a
+// chain of Fast_LogPlusEquals() calls, neither pass carries a branch
+// or a serial dependency on the previous log-space sum, so the loops
+// are vectorized by the compiler.
+//////////////////////////////////////////////////////////////////////
+
+inline double Fast_LogSumExp(const double *x, int n)
+{
+    double m = double(NEG_INF);
+    for (int k = 0; k < n; k++)
+        m = std::max(m, x[k]);
+    if (m <= double(NEG_INF/2)) return double(NEG_INF);
+    double sum = 0;
+    for (int k = 0; k < n; k++)
+        sum += Fast_Exp(x[k] - m);
+    return m + log(sum);
+}
+
+inline float Fast_LogSumExp(const float *x, int n)
+{
+    float m = float(NEG_INF);
+#pragma omp simd reduction(max:m)
+    for (int k = 0; k < n; k++)
+        m = std::max(m, x[k]);
+    if (m <= float(NEG_INF/2)) return float(NEG_INF);
+    float sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (int k = 0; k < n; k++)
+        sum += Vec_Exp(x[k] - m);
+    return m + logf(sum);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Fast_LogPlusEqualsArray()
+//
+// Compute x[k] = log(exp(x[k])+exp(c+y[k])) for 0<=k<n.
+//////////////////////////////////////////////////////////////////////
+
+inline void Fast_LogPlusEqualsArray(double *x, const double *y, double c, int n)
+{
+    for (int k = 0; k < n; k++)
+        Fast_LogPlusEquals(x[k], c + y[k]);
+}
+
+inline void Fast_LogPlusEqualsArray(float *x, const float *y, float c, int n)
+{
+#pragma omp simd
+    for (int k = 0; k < n; k++)
+    {
+        const float a = x[k];
+        const float b = c + y[k];
+        const float hi = a > b ? a : b;
+        x[k] = hi + Vec_LogExpPlusOne(-std::fabs(a - b));
+    }
+}
+
 //////////////////////////////////////////////////////////////////////
 // Fast_LogSubtract()
 // Fast_LogMinusEquals()
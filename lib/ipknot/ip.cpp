@@ -27,6 +27,7 @@
 #include <stdexcept>
 #ifdef WITH_GLPK
 #include <glpk.h>
+#include <mutex>
 #endif
 #ifdef WITH_CPLEX
 extern "C" {
@@ -39,12 +40,45 @@ extern "C" {
 #include <cfloat>
 
 #ifdef WITH_GLPK
+// GLPK keeps its environment (memory pools, terminal hooks) in thread-local storage only if the library was
+// built with TLS support. Otherwise all threads share one environment, which is not thread-safe, so that the
+// GLPK calls of problems that are solved concurrently (e.g. the independent regions in IPknot) are serialized.
+class GlpkGuard
+{
+public:
+  GlpkGuard() : lock_(mutex(), std::defer_lock)
+  {
+    if (!thread_local_env())
+      lock_.lock();
+  }
+
+private:
+  static bool thread_local_env()
+  {
+#if GLP_MAJOR_VERSION > 4 || (GLP_MAJOR_VERSION == 4 && GLP_MINOR_VERSION >= 58)
+    static const bool tls = glp_config("TLS") != NULL;
+    return tls;
+#else
+    return false;
+#endif
+  }
+
+  static std::mutex& mutex()
+  {
+    static std::mutex m;
+    return m;
+  }
+
+  std::unique_lock<std::mutex> lock_;
+};
+
 class IPimpl
 {
 public:
   IPimpl(IP::DirType dir, int n_th)
     : ip_(NULL), ia_(1), ja_(1), ar_(1)
   {
+    GlpkGuard guard;
     ip_ = glp_create_prob();
     switch (dir)
     {
@@ -55,11 +89,13 @@ public:
 
   ~IPimpl()
   {
+    GlpkGuard guard;
     glp_delete_prob(ip_);
   }
 
   int make_variable(double coef)
   {
+    GlpkGuard guard;
     int col = glp_add_cols(ip_, 1);
     glp_set_col_bnds(ip_, col, GLP_DB, 0, 1);
     glp_set_col_kind(ip_, col, GLP_BV);
@@ -69,6 +105,7 @@ public:
 
   int make_variable(double coef, int lo, int hi)
   {
+    GlpkGuard guard;
     int col = glp_add_cols(ip_, 1);
     glp_set_col_bnds(ip_, col, GLP_DB, lo, hi);
     glp_set_col_kind(ip_, col, GLP_IV);
@@ -78,6 +115,7 @@ public:
 
   int make_constraint(IP::BoundType bnd, double l, double u)
   {
+    GlpkGuard guard;
     int row = glp_add_rows(ip_, 1);
     switch (bnd)
     {
@@ -103,6 +141,7 @@ public:
 
   double solve()
   {
+    GlpkGuard guard;
     glp_smcp smcp;
     glp_iocp iocp;
     glp_init_smcp(&smcp); smcp.msg_lev = GLP_MSG_ERR;
@@ -115,6 +154,7 @@ public:
 
   double get_value(int col) const
   {
+    GlpkGuard guard;
     return glp_mip_col_val(ip_, col);
   }
 
@@ -45,7 +45,78 @@ public:
   void solve(uint L, const std::vector<float>& bp, const std::vector<int>& offset,
              const std::vector<float>& th, std::vector<int>& bpseq, std::vector<int>& plevel) const
   {
-    IP ip(IP::MAX, n_th_);
+    bpseq.assign(L, -1);
+    plevel.assign(L, -1);
+
+    // The objective is a sum over base pairs and every constraint only relates base pairs that share
+    // a position or whose spans overlap. Thus, the problem decomposes exactly into independent regions
+    // that are separated by stretches which are not spanned by any candidate base pair.
+    // The pseudoknot levels are coupled by constraints 1 and 3 and are solved jointly within a region.
+    std::vector<std::pair<uint, uint> > regions;
+    find_regions(L, bp, offset, th, regions);
+
+    // solve the largest regions first for a better load balance
+    // (each region has its own IP object; the GLPK backend serializes its calls unless GLPK has per-thread
+    // environments, see GlpkGuard in ip.cpp, while the other backends create an environment per problem)
+    std::sort(regions.begin(), regions.end(), cmp_by_length());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(std::max(n_th_, 1))
+#endif
+    for (int r=0; r<(int)regions.size(); ++r)
+      solve_region(regions[r].first, regions[r].second, bp, offset, th, bpseq, plevel);
+
+    if (!levelwise_)
+      decompose_plevel(bpseq, plevel);
+  }
+
+private:
+  struct cmp_by_length
+  {
+    bool operator()(const std::pair<uint, uint>& x, const std::pair<uint, uint>& y) const
+    {
+      return y.second-y.first < x.second-x.first;
+    }
+  };
+
+  // find the maximal intervals [first,second] whose positions are connected through overlapping candidate pairs
+  void find_regions(uint L, const std::vector<float>& bp, const std::vector<int>& offset,
+                    const std::vector<float>& th, std::vector<std::pair<uint, uint> >& regions) const
+  {
+    const float min_th = *std::min_element(th.begin(), th.begin()+pk_level_);
+    bool open=false;
+    uint begin=0, end=0;
+    for (uint i=0; i<L; ++i)
+    {
+      // find the most distant candidate partner of i
+      uint far=i;
+      for (uint j=L-1; j>i; --j)
+        if (bp[offset[i+1]+(j+1)]>min_th)
+        {
+          far=j;
+          break;
+        }
+      if (far==i) continue;
+
+      if (open && i<=end)
+      {
+        end=std::max(end, far);
+      }
+      else
+      {
+        if (open) regions.push_back(std::make_pair(begin, end));
+        begin=i; end=far; open=true;
+      }
+    }
+    if (open) regions.push_back(std::make_pair(begin, end));
+  }
+
+  // solve the subproblem for the positions in [b,e] and write the result into bpseq and plevel
+  void solve_region(uint b, uint e, const std::vector<float>& bp, const std::vector<int>& offset,
+                    const std::vector<float>& th, std::vector<int>& bpseq, std::vector<int>& plevel) const
+  {
+    const uint L=e-b+1;
+    IP ip(IP::MAX, 1);
     VVVI v(pk_level_, VVI(L, VI(L, -1)));
     VVVI w(pk_level_, VVI(L));
 
@@ -54,7 +125,7 @@ public:
     {
       for (uint i=j-1; i!=-1u; --i)
       {
-        const float& p=bp[offset[i+1]+(j+1)];
+        const float& p=bp[offset[b+i+1]+(b+j+1)];
         for (uint lv=0; lv!=pk_level_; ++lv)
           if (p>th[lv])
           {
@@ -173,24 +244,17 @@ public:
     // execute optimization
     ip.solve();
 
-    // build the result
-    bpseq.resize(L);
-    std::fill(bpseq.begin(), bpseq.end(), -1);
-    plevel.resize(L);
-    std::fill(plevel.begin(), plevel.end(), -1);
+    // build the result (the regions are disjoint, so concurrent writes do not interfere)
     for (uint lv=0; lv!=pk_level_; ++lv)
     {
       for (uint i=0; i<L; ++i)
         for (uint j=i+1; j<L; ++j)
           if (v[lv][i][j]>=0 && ip.get_value(v[lv][i][j])>0.5)
           {
-            bpseq[i]=j; bpseq[j]=i;
-            plevel[i]=plevel[j]=lv;
+            bpseq[b+i]=b+j; bpseq[b+j]=b+i;
+            plevel[b+i]=plevel[b+j]=lv;
           }
     }
-
-    if (!levelwise_)
-      decompose_plevel(bpseq, plevel);
   }
 
 public:
@@ -480,11 +544,22 @@ update_bpm(uint pk_level, const SEQ& seq, EN& en,
 //		seqs.push_back(record.seqences.at(name));
 //	}
 
+// create the engine for the base pair probabilities of an alignment: either fold the alignment once with
+// covariation-aware energies (alifold), or average the probabilities of the individual sequences
+static BPEngineAln*
+make_aln_engine(bool alifold, BPEngineSeq* en)
+{
+  if (alifold)
+    return new AlifoldModel(NULL);
+  return new AveragedModel(en);
+}
+
 std::pair<std::vector<int>, std::vector<int>> run_ipknot(std::list<std::string> const & names,
-                                                         std::list<std::string> const & seqs)
+                                                         std::list<std::string> const & seqs,
+                                                         int n_th,
+                                                         bool alifold)
 {
 	bool isolated_bp=false;
-	int n_th=1;
 //	int n_refinement=0;
 	std::vector<std::vector<float>> th{{1/(2.0+1)}, {1/(4.0+1)}};
 	std::vector<float> alpha;
@@ -541,7 +616,7 @@ std::pair<std::vector<int>, std::vector<int>> run_ipknot(std::list<std::string>
     //en_a.push_back(new AlifoldModel(param));
     //mix_en = new MixtureModel(en_a);
 
-	BPEngineAln* en = new AveragedModel(e2);
+	BPEngineAln* en = make_aln_engine(alifold, e2);
 //	BPEngineAln* en = en_a[0];
 //	BPEngineAln* en= mix_en ? mix_en : en_a[0];
 	en->calculate_posterior(aln.seq(), bp, offset);
@@ -581,3 +656,140 @@ std::pair<std::vector<int>, std::vector<int>> run_ipknot(std::list<std::string>
 
     return std::move(std::make_pair(bpseq, plevel));
 }
+
+/* Maximum expected accuracy folding */
+
+// Fill the gamma-centroid DP over the candidate pairs with posterior > th and trace back the optimal nested
+// structure. Positions that are already paired in bpseq are excluded; the new pairs are written to pairs.
+static void
+mea_fold(uint L, const std::vector<float>& bp, const std::vector<int>& offset, float th,
+         const std::vector<int>& bpseq, std::vector<int>& pairs)
+{
+  pairs.assign(L, -1);
+  if (L<2) return;
+
+  // there are at most 1/th candidate partners per position, which makes the DP O(L^2) instead of O(L^3)
+  VVI cand(L);
+  for (uint i=0; i!=L; ++i)
+    if (bpseq[i]<0)
+      for (uint k=i+1; k!=L; ++k)
+        if (bpseq[k]<0 && bp[offset[i+1]+(k+1)]>th)
+          cand[i].push_back(k);
+
+  // S(i,j) is the maximal gain of a nested structure in [i,j], stored at i*L+j for i<=j
+  std::vector<float> S(L*L, 0.0);
+  auto score = [&S, L] (uint i, uint j) { return i<j ? S[i*L+j] : 0.0f; };
+  auto gain = [&] (uint i, uint k, uint j)
+  {
+    return bp[offset[i+1]+(k+1)] - th + score(i+1, k-1) + score(k+1, j);
+  };
+
+  for (uint i=L-1; i!=-1u; --i)
+    for (uint j=i+1; j!=L; ++j)
+    {
+      float best = score(i+1, j);
+      for (uint k : cand[i])
+        if (k<=j)
+          best = std::max(best, gain(i, k, j));
+      S[i*L+j] = best;
+    }
+
+  // traceback
+  std::vector<std::pair<uint, uint> > st(1, std::make_pair(0u, L-1));
+  while (!st.empty())
+  {
+    const uint i=st.back().first, j=st.back().second;
+    st.pop_back();
+    if (i>=j) continue;
+    const float best = S[i*L+j];
+    if (best==score(i+1, j))
+    {
+      st.push_back(std::make_pair(i+1, j));
+      continue;
+    }
+    for (uint k : cand[i])
+      if (k<=j && best==gain(i, k, j))
+      {
+        pairs[i]=k; pairs[k]=i;
+        st.push_back(std::make_pair(i+1, k-1));
+        if (k+1<=j) st.push_back(std::make_pair(k+1, j));
+        break;
+      }
+  }
+}
+
+// remove the base pairs of level lv that are not stacked on another pair of the same level
+static void
+remove_lonely_pairs(std::vector<int>& bpseq, std::vector<int>& plevel, int lv)
+{
+  const int L=bpseq.size();
+  bool changed=true;
+  while (changed)
+  {
+    changed=false;
+    for (int i=0; i!=L; ++i)
+    {
+      const int j=bpseq[i];
+      if (j<=i || plevel[i]!=lv) continue;
+      const bool inner = i+1<j-1 && bpseq[i+1]==j-1 && plevel[i+1]==lv;
+      const bool outer = i>0 && j+1<L && bpseq[i-1]==j+1 && plevel[i-1]==lv;
+      if (!inner && !outer)
+      {
+        bpseq[i]=bpseq[j]=-1;
+        plevel[i]=plevel[j]=-1;
+        changed=true;
+      }
+    }
+  }
+}
+
+std::pair<std::vector<int>, std::vector<int>> run_mea(std::list<std::string> const & names,
+                                                      std::list<std::string> const & seqs,
+                                                      bool pseudoknots,
+                                                      bool alifold)
+{
+  // the same thresholds as the first two levels of run_ipknot (gamma = 2 and gamma = 4)
+  const float th[2] = {1/(2.0+1), 1/(4.0+1)};
+
+  Aln aln(names, seqs);
+  CONTRAfoldModel e;
+  BPEngineAln* en = make_aln_engine(alifold, &e);
+  std::vector<float> bp;
+  std::vector<int> offset;
+  en->calculate_posterior(aln.seq(), bp, offset);
+  delete en;
+
+  const uint L=aln.size();
+  std::vector<int> bpseq(L, -1);
+  std::vector<int> plevel(L, -1);
+
+  // level 0: the pseudoknot-free MEA structure
+  mea_fold(L, bp, offset, th[0], std::vector<int>(L, -1), bpseq);
+  for (uint i=0; i!=L; ++i)
+    if (bpseq[i]>=0) plevel[i]=0;
+  remove_lonely_pairs(bpseq, plevel, 0);
+
+  if (pseudoknots)
+  {
+    // level 1: fold the remaining positions greedily and keep the pairs that cross a level 0 pair
+    std::vector<int> pk;
+    mea_fold(L, bp, offset, th[1], bpseq, pk);
+    for (uint k=0; k!=L; ++k)
+    {
+      const int l=pk[k];
+      if (l<=(int)k) continue;
+      bool crossing=false;
+      for (uint i=0; i!=L && !crossing; ++i)
+        if (bpseq[i]>(int)i && plevel[i]==0)
+          crossing = (i<k && (int)k<bpseq[i] && bpseq[i]<l) || (k<i && (int)i<l && l<bpseq[i]);
+      if (crossing)
+      {
+        bpseq[k]=l; bpseq[l]=k;
+        plevel[k]=plevel[l]=1;
+      }
+    }
+    remove_lonely_pairs(bpseq, plevel, 1);
+  }
+
+  return std::make_pair(bpseq, plevel);
+}
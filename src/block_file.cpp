@@ -0,0 +1,213 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef SEQAN3_HAS_ZLIB
+    #include <zlib.h>
+#endif
+
+#include <seqan3/io/exception.hpp>
+
+#include "block_file.hpp"
+#include "parallel_for.hpp"
+
+namespace mars
+{
+
+//! \brief The magic string at the start of a block-compressed container.
+static constexpr std::string_view block_file_magic{"MARSBLK1"};
+
+//! \brief The uncompressed size of a block.
+static constexpr uint64_t block_size{1ul << 20};
+
+//! \brief Append the binary representation of a number to a string.
+template <typename number_t>
+static void put(std::string & out, number_t value)
+{
+    out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+void BlockFileWriter::write(std::filesystem::path const & filepath) const
+{
+    // Split the components into blocks.
+    std::vector<std::pair<std::string const *, uint64_t>> block_sources{}; // component data and start position
+    for (auto const & [name, data] : components)
+        for (uint64_t pos = 0; pos < data.size(); pos += block_size)
+            block_sources.emplace_back(&data, pos);
+
+    // Compress the blocks in parallel.
+    std::vector<std::string> packed(block_sources.size());
+    parallel_for(block_sources.size(), [&block_sources, &packed] (size_t idx)
+    {
+        auto const & [data, pos] = block_sources[idx];
+        size_t const len = std::min<uint64_t>(block_size, data->size() - pos);
+#ifdef SEQAN3_HAS_ZLIB
+        uLongf packed_len = compressBound(len);
+        packed[idx].resize(packed_len);
+        if (compress2(reinterpret_cast<Bytef *>(packed[idx].data()), &packed_len,
+                      reinterpret_cast<Bytef const *>(data->data() + pos), len, Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw std::runtime_error{"Could not compress a block of the index."};
+        packed[idx].resize(packed_len);
+#else
+        packed[idx].assign(*data, pos, len);
+#endif
+    });
+
+    // Assemble the header with the component and block tables.
+    std::string header{block_file_magic};
+#ifdef SEQAN3_HAS_ZLIB
+    put<uint32_t>(header, 1u);
+#else
+    put<uint32_t>(header, 0u);
+#endif
+    put<uint32_t>(header, components.size());
+    uint64_t first_block{0};
+    for (auto const & [name, data] : components)
+    {
+        uint64_t const block_count = (data.size() + block_size - 1) / block_size;
+        put<uint32_t>(header, name.size());
+        header.append(name);
+        put<uint64_t>(header, data.size());
+        put<uint64_t>(header, first_block);
+        put<uint64_t>(header, block_count);
+        first_block += block_count;
+    }
+    put<uint64_t>(header, packed.size());
+    uint64_t offset = header.size() + packed.size() * (sizeof(uint64_t) + 2 * sizeof(uint32_t));
+    for (size_t idx = 0; idx < packed.size(); ++idx)
+    {
+        auto const & [data, pos] = block_sources[idx];
+        put<uint64_t>(header, offset);
+        put<uint32_t>(header, packed[idx].size());
+        put<uint32_t>(header, std::min<uint64_t>(block_size, data->size() - pos));
+        offset += packed[idx].size();
+    }
+
+    std::ofstream ofs{filepath, std::ios::binary};
+    if (!ofs)
+        throw seqan3::file_open_error{"Could not write the file ==> " + filepath.string()};
+    ofs.write(header.data(), header.size());
+    for (std::string const & block : packed)
+        ofs.write(block.data(), block.size());
+    ofs.close();
+    if (!ofs)
+        throw seqan3::file_open_error{"Could not write the file ==> " + filepath.string()};
+}
+
+bool BlockFileReader::is_block_file(std::filesystem::path const & filepath)
+{
+    std::ifstream ifs{filepath, std::ios::binary};
+    std::string magic(block_file_magic.size(), '\0');
+    return ifs.read(magic.data(), magic.size()) && magic == block_file_magic;
+}
+
+//! \brief Read the binary representation of a number from a stream.
+template <typename number_t>
+static number_t get(std::istream & in)
+{
+    number_t value{};
+    if (!in.read(reinterpret_cast<char *>(&value), sizeof(value)))
+        throw seqan3::parse_error{"Unexpected end of the block table."};
+    return value;
+}
+
+BlockFileReader::BlockFileReader(std::filesystem::path filepath) : filepath{std::move(filepath)}
+{
+    std::ifstream ifs{this->filepath, std::ios::binary};
+    if (!ifs)
+        throw seqan3::file_open_error{"Could not open the file <== " + this->filepath.string()};
+
+    std::string magic(block_file_magic.size(), '\0');
+    if (!ifs.read(magic.data(), magic.size()) || magic != block_file_magic)
+        throw seqan3::parse_error{"Not a MaRs block file: " + this->filepath.string()};
+
+    compressed = get<uint32_t>(ifs) != 0u;
+#ifndef SEQAN3_HAS_ZLIB
+    if (compressed)
+        throw seqan3::parse_error{"Reading a compressed block file requires zlib: " + this->filepath.string()};
+#endif
+    components.resize(get<uint32_t>(ifs));
+    for (Component & component : components)
+    {
+        component.name.resize(get<uint32_t>(ifs));
+        ifs.read(component.name.data(), component.name.size());
+        component.size = get<uint64_t>(ifs);
+        component.first_block = get<uint64_t>(ifs);
+        component.block_count = get<uint64_t>(ifs);
+    }
+    blocks.resize(get<uint64_t>(ifs));
+    for (Block & block : blocks)
+    {
+        block.offset = get<uint64_t>(ifs);
+        block.compressed_size = get<uint32_t>(ifs);
+        block.size = get<uint32_t>(ifs);
+    }
+    for (Component const & component : components)
+        if (component.first_block + component.block_count > blocks.size())
+            throw seqan3::parse_error{"Invalid block table in " + this->filepath.string()};
+}
+
+bool BlockFileReader::contains(std::string_view name) const
+{
+    return std::any_of(components.cbegin(), components.cend(), [name] (Component const & component)
+    {
+        return component.name == name;
+    });
+}
+
+std::string BlockFileReader::read(std::string_view name) const
+{
+    auto const component = std::find_if(components.cbegin(), components.cend(), [name] (Component const & comp)
+    {
+        return comp.name == name;
+    });
+    if (component == components.cend())
+        throw seqan3::parse_error{"The component " + std::string{name} + " is missing in " + filepath.string()};
+
+    std::string result(component->size, '\0');
+    if (component->block_count == 0)
+        return result;
+
+    // Read the compressed blocks of the component at once, they are stored consecutively.
+    Block const & first = blocks[component->first_block];
+    Block const & last = blocks[component->first_block + component->block_count - 1];
+    std::string packed(last.offset + last.compressed_size - first.offset, '\0');
+    {
+        std::ifstream ifs{filepath, std::ios::binary};
+        ifs.seekg(first.offset);
+        if (!ifs.read(packed.data(), packed.size()))
+            throw seqan3::parse_error{"Unexpected end of the file " + filepath.string()};
+    }
+
+    // Inflate the blocks in parallel.
+    parallel_for(component->block_count, [this, &component, &first, &packed, &result] (size_t idx)
+    {
+        Block const & block = blocks[component->first_block + idx];
+        uint64_t const target = idx * block_size;
+        if (target + block.size > result.size())
+            throw seqan3::parse_error{"Invalid block size in " + filepath.string()};
+
+        char const * source = packed.data() + (block.offset - first.offset);
+        if (!compressed)
+        {
+            std::memcpy(result.data() + target, source, block.size);
+            return;
+        }
+#ifdef SEQAN3_HAS_ZLIB
+        uLongf len = block.size;
+        if (uncompress(reinterpret_cast<Bytef *>(result.data() + target), &len,
+                       reinterpret_cast<Bytef const *>(source), block.compressed_size) != Z_OK || len != block.size)
+            throw seqan3::parse_error{"Corrupt block in " + filepath.string()};
+#endif
+    });
+    return result;
+}
+
+} // namespace mars
@@ -0,0 +1,115 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <seqan3/std/filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mars
+{
+
+/*!
+ * \brief Writes named components into a block-compressed container file.
+ *
+ * \details
+ * Each component is split into blocks of 1 MiB that are compressed independently and in parallel. The file
+ * starts with a table of all components and blocks, such that a reader can inflate the blocks in parallel
+ * and load individual components without touching the others. Without zlib the blocks are stored uncompressed.
+ */
+class BlockFileWriter
+{
+private:
+    //! \brief The names and data of the components.
+    std::vector<std::pair<std::string, std::string>> components;
+
+public:
+    /*!
+     * \brief Add a component to the container.
+     * \param name The name of the component, which must be unique.
+     * \param data The raw data of the component.
+     */
+    void add(std::string name, std::string data)
+    {
+        components.emplace_back(std::move(name), std::move(data));
+    }
+
+    /*!
+     * \brief Compress the components and write the container.
+     * \param filepath The output file.
+     * \throws seqan3::file_open_error if the file cannot be written.
+     */
+    void write(std::filesystem::path const & filepath) const;
+};
+
+//! \brief Reads components from a block-compressed container file, see BlockFileWriter.
+class BlockFileReader
+{
+private:
+    //! \brief A named component, which consists of consecutive blocks.
+    struct Component
+    {
+        std::string name; //!< The name of the component.
+        uint64_t size; //!< The uncompressed size.
+        uint64_t first_block; //!< The index of the first block.
+        uint64_t block_count; //!< The number of blocks.
+    };
+
+    //! \brief A compressed block.
+    struct Block
+    {
+        uint64_t offset; //!< The file offset of the compressed data.
+        uint32_t compressed_size; //!< The size of the compressed data.
+        uint32_t size; //!< The uncompressed size.
+    };
+
+    //! \brief The container file.
+    std::filesystem::path filepath;
+    //! \brief Whether the blocks are compressed with zlib.
+    bool compressed;
+    //! \brief The components in the container.
+    std::vector<Component> components;
+    //! \brief The blocks of all components.
+    std::vector<Block> blocks;
+
+public:
+    /*!
+     * \brief Read the component and block table of a container.
+     * \param filepath The container file.
+     * \throws seqan3::file_open_error if the file cannot be opened.
+     * \throws seqan3::parse_error if the file is not a valid container.
+     */
+    explicit BlockFileReader(std::filesystem::path filepath);
+
+    /*!
+     * \brief Check whether a file is a block-compressed container.
+     * \param filepath The file to be checked.
+     * \return whether the file starts with the magic string of the container.
+     */
+    static bool is_block_file(std::filesystem::path const & filepath);
+
+    /*!
+     * \brief Check whether a component exists.
+     * \param name The name of the component.
+     * \return whether the container has a component with this name.
+     */
+    bool contains(std::string_view name) const;
+
+    /*!
+     * \brief Load a component, inflating its blocks in parallel.
+     * \param name The name of the component.
+     * \return the raw data of the component.
+     * \throws seqan3::parse_error if the component does not exist or its data is corrupt.
+     */
+    std::string read(std::string_view name) const;
+};
+
+} // namespace mars
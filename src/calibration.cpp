@@ -0,0 +1,138 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <future>
+#include <iterator>
+#include <numeric>
+#include <random>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+
+#include "calibration.hpp"
+#include "index.hpp"
+#include "phase_report.hpp"
+#include "search.hpp"
+#include "settings.hpp"
+#include "trace.hpp"
+
+namespace mars
+{
+
+//! \brief The number of background windows, whose maximum scores are fitted.
+static constexpr size_t calibration_windows{256};
+
+//! \brief The minimum length of a background window.
+static constexpr uint32_t calibration_window_length{1000};
+
+ScoreCalibration fit_gumbel(std::vector<float> maxima, size_t windows, uint32_t window)
+{
+    ScoreCalibration calibration{};
+    if (maxima.size() < 2 || windows < maxima.size())
+        return calibration;
+
+    // The Gumbel distribution has the quantiles mu - log(-log(p)) / lambda. The windows without a hit take the
+    // lowest ranks, and each observed maximum is paired with the quantile of its rank (Gringorten plotting position).
+    std::sort(maxima.begin(), maxima.end());
+    size_t const censored = windows - maxima.size();
+    std::vector<double> reduced(maxima.size());
+    for (size_t idx = 0; idx < maxima.size(); ++idx)
+        reduced[idx] = -std::log(-std::log((censored + idx + 1 - 0.44) / (windows + 0.12)));
+
+    // Fit the line through the points by least squares, whose slope is 1 / lambda and whose intercept is mu.
+    double const mean_score = std::accumulate(maxima.begin(), maxima.end(), 0.) / maxima.size();
+    double const mean_reduced = std::accumulate(reduced.begin(), reduced.end(), 0.) / reduced.size();
+    double covariance{0};
+    double variance{0};
+    for (size_t idx = 0; idx < maxima.size(); ++idx)
+    {
+        covariance += (reduced[idx] - mean_reduced) * (maxima[idx] - mean_score);
+        variance += (reduced[idx] - mean_reduced) * (reduced[idx] - mean_reduced);
+    }
+    double const slope = covariance / variance;
+    if (!(slope > 0))
+        return calibration;
+
+    calibration.lambda = static_cast<float>(1 / slope);
+    calibration.mu = static_cast<float>(mean_score - slope * mean_reduced);
+    calibration.window = window;
+    return calibration;
+}
+
+void calibrate_motif(Motif & motif)
+{
+    if (std::isnan(settings.search_evalue))
+        return;
+
+    std::vector<size_t> stemloops{};
+    uint32_t window{calibration_window_length};
+    for (size_t idx = 0; idx < motif.size(); ++idx)
+    {
+        if (!motif[idx].calibration.valid())
+        {
+            stemloops.push_back(idx);
+            window = std::max<uint32_t>(window, 4u * motif[idx].length.second);
+        }
+    }
+    if (stemloops.empty())
+        return;
+
+    PhaseReport::Timer const timer = phase_report.measure("calibration");
+    TraceScope const trace{"calibrate motif"};
+
+    // Generate the background windows with the base composition that the scores are relative to.
+    std::array<double, 4> weights{};
+    for (size_t rnk = 0; rnk < weights.size(); ++rnk)
+        weights[rnk] = exp2(profile_char<seqan3::rna4>::background_distribution[rnk]);
+    std::mt19937_64 generator{0x6d617273}; // a fixed seed makes the calibration reproducible
+    std::discrete_distribution<int> base{weights.begin(), weights.end()};
+    std::vector<std::vector<seqan3::dna4>> background(calibration_windows, std::vector<seqan3::dna4>(window));
+    for (std::vector<seqan3::dna4> & sequence : background)
+        for (seqan3::dna4 & chr : sequence)
+            chr.assign_rank(base(generator));
+    Index const index{background};
+
+    // Search the stemloops in the background without pruning, and wait for the locations.
+    StemloopHitStore hits(calibration_windows);
+    ConcurrentFutureVector queries;
+    std::vector<std::future<void>> search_tasks;
+    for (size_t idx : stemloops)
+    {
+        search_tasks.push_back(pool->submit([&index, &motif, &hits, &queries, idx]
+        {
+            SearchProgram const program{motif[idx]};
+            SearchInfo info(index, motif[idx], hits, queries);
+            info.search(program);
+        }));
+    }
+    for (auto & future : search_tasks)
+        future.wait();
+    for (auto & future : queries.futures)
+        future.wait();
+
+    // Fit the best score of each stemloop per window, where hits have positive scores and zero means no hit.
+    std::vector<std::vector<float>> maxima(motif.size(), std::vector<float>(calibration_windows, 0.f));
+    for (size_t sidx = 0; sidx < calibration_windows; ++sidx)
+        for (StemloopHit const & hit : hits.get(sidx))
+            if (hit.midx < motif.size())
+                maxima[hit.midx][sidx] = std::max(maxima[hit.midx][sidx], hit.score);
+    for (size_t idx : stemloops)
+    {
+        std::vector<float> observed{};
+        std::copy_if(maxima[idx].begin(), maxima[idx].end(), std::back_inserter(observed),
+                     [] (float score) { return score > 0; });
+        motif[idx].calibration = fit_gumbel(std::move(observed), calibration_windows, window);
+        logger(2, "Stemloop " << (idx + 1) << ": lambda = " << motif[idx].calibration.lambda
+                  << ", mu = " << motif[idx].calibration.mu << std::endl);
+    }
+    logger(1, "Calibrated the scores of " << stemloops.size() << " stemloops on " << calibration_windows
+              << " background windows of length " << window << "." << std::endl);
+}
+
+} // namespace mars
@@ -0,0 +1,42 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "motif.hpp"
+
+namespace mars
+{
+
+/*!
+ * \brief Fit a Gumbel distribution to the maximum scores of a stemloop in background windows.
+ * \param maxima The maximum score of the stemloop in each window that contains a hit.
+ * \param windows The number of windows, including those without a hit.
+ * \param window The length of the windows.
+ * \return the fitted distribution, which is not valid if there are less than two maxima or they do not vary.
+ *
+ * \details
+ * The windows without a hit are censored: their maximum is unknown, but below the observed maxima. Thus they are
+ * not counted as zero scores, but only take the lowest ranks when the sorted maxima are matched with the quantiles
+ * of the distribution, and the parameters are estimated by a least squares fit of the quantiles.
+ */
+ScoreCalibration fit_gumbel(std::vector<float> maxima, size_t windows, uint32_t window);
+
+/*!
+ * \brief Calibrate the score distribution of the stemloops, if the settings request a search e-value.
+ * \param motif The motif, whose stemloops receive the fitted distributions.
+ *
+ * \details
+ * The stemloops are searched once in random background sequence that follows the base composition of the scores,
+ * and the distribution of their best score per window is fitted. Stemloops that have been calibrated before,
+ * e.g. in a restored motif file, are kept, such that the calibration is stored with the motif.
+ */
+void calibrate_motif(Motif & motif);
+
+} // namespace mars
@@ -0,0 +1,109 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "packed_text.hpp"
+
+namespace mars
+{
+
+/*!
+ * \brief A 128-bit hash of the genome content, which identifies an index in the cache directory.
+ *
+ * \details
+ * The hash consists of two lanes of xxHash64-like rounds with different seeds. It does not depend on the platform
+ * or the standard library, such that all machines that share a cache directory agree on the keys. It is not a
+ * cryptographic hash. The sequences are hashed 32 nucleotides at a time, such that hashing costs much less than
+ * parsing the sequence file.
+ */
+class ContentHash
+{
+private:
+    static constexpr uint64_t prime1{0x9E3779B185EBCA87ull}; //!< First multiplier of xxHash64.
+    static constexpr uint64_t prime2{0xC2B2AE3D27D4EB4Full}; //!< Second multiplier of xxHash64.
+    static constexpr uint64_t prime3{0x165667B19E3779F9ull}; //!< Third multiplier of xxHash64.
+
+    uint64_t lane1{0x243F6A8885A308D3ull}; //!< The first hash lane.
+    uint64_t lane2{0x13198A2E03707344ull}; //!< The second hash lane.
+    uint64_t length{0}; //!< The number of hashed words.
+
+    //! \brief Rotate a word to the left.
+    static constexpr uint64_t rotl(uint64_t word, unsigned shift)
+    {
+        return (word << shift) | (word >> (64 - shift));
+    }
+
+    //! \brief Mix all bits of a lane.
+    static constexpr uint64_t avalanche(uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+public:
+    //! \brief Add a 64-bit word to the hash.
+    void update(uint64_t word)
+    {
+        lane1 = rotl(lane1 + word * prime2, 31) * prime1;
+        lane2 = rotl(lane2 ^ (word * prime3), 29) * prime2;
+        ++length;
+    }
+
+    //! \brief Add a string and its length to the hash.
+    void update(std::string_view str)
+    {
+        update(static_cast<uint64_t>(str.size()));
+        for (size_t pos = 0; pos < str.size(); pos += sizeof(uint64_t))
+        {
+            uint64_t word{0};
+            std::memcpy(&word, str.data() + pos, std::min(sizeof(uint64_t), str.size() - pos));
+            update(word);
+        }
+    }
+
+    //! \brief Add a nucleotide sequence and its length to the hash.
+    void update(PackedText::Sequence const & seq)
+    {
+        update(static_cast<uint64_t>(seq.size()));
+        uint64_t word{0};
+        for (size_t pos = 0; pos < seq.size(); ++pos)
+        {
+            word = (word << 2) | seq[pos].to_rank();
+            if (pos % 32 == 31)
+            {
+                update(word);
+                word = 0;
+            }
+        }
+        if (seq.size() % 32 != 0)
+            update(word);
+    }
+
+    //! \brief The hash as a string of 32 hexadecimal digits.
+    std::string hex() const
+    {
+        char const digits[] = "0123456789abcdef";
+        std::string result{};
+        for (uint64_t hash : {avalanche(lane1 ^ length), avalanche(lane2 + length * prime1)})
+            for (int shift = 60; shift >= 0; shift -= 4)
+                result.push_back(digits[(hash >> shift) & 0xF]);
+        return result;
+    }
+};
+
+} // namespace mars
@@ -0,0 +1,231 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <seqan3/alphabet/concept.hpp>
+#include <seqan3/alphabet/gap/gapped.hpp>
+#include <seqan3/alphabet/aminoacid/aa27.hpp>
+#include <seqan3/alphabet/nucleotide/rna15.hpp>
+#include <seqan3/core/range/detail/misc.hpp>
+#include <seqan3/io/exception.hpp>
+
+namespace mars
+{
+
+//! \brief Holds a complete input stream in memory and provides fast line-wise access for the alignment parsers.
+class LineBuffer
+{
+private:
+    //! \brief The content of the stream.
+    std::string buffer{};
+    //! \brief The current read position in the buffer.
+    size_t pos{0};
+
+public:
+    /*!
+     * \brief Constructor that reads the stream in large blocks.
+     * \param stream The input stream.
+     */
+    explicit LineBuffer(std::istream & stream)
+    {
+        size_t constexpr block_size = 1ul << 20;
+        while (stream)
+        {
+            size_t const old_size = buffer.size();
+            buffer.resize(old_size + block_size);
+            stream.read(&buffer[old_size], block_size);
+            buffer.resize(old_size + static_cast<size_t>(stream.gcount()));
+        }
+    }
+
+    /*!
+     * \brief Test a character for whitespace.
+     * \param chr The character.
+     * \return whether `chr` is a space, tab, or line break.
+     */
+    static constexpr bool is_space(char chr)
+    {
+        return chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r' || chr == '\v' || chr == '\f';
+    }
+
+    /*!
+     * \brief Extract the next word of a line, i.e. skip leading blanks and read until the next whitespace.
+     * \param[in,out] line The line, which is shortened to the part behind the word.
+     * \return The word, or an empty string if the line contains no more words.
+     */
+    static std::string_view next_word(std::string_view & line)
+    {
+        size_t begin = 0;
+        while (begin < line.size() && is_space(line[begin]))
+            ++begin;
+        size_t end = begin;
+        while (end < line.size() && !is_space(line[end]))
+            ++end;
+        std::string_view const word = line.substr(begin, end - begin);
+        line.remove_prefix(end);
+        return word;
+    }
+
+    //! \brief Whether the complete input has been read.
+    bool eof() const
+    {
+        return pos >= buffer.size();
+    }
+
+    //! \brief The next character, or a null character at the end of the input.
+    char peek() const
+    {
+        return eof() ? '\0' : buffer[pos];
+    }
+
+    //! \brief The current read position.
+    size_t position() const
+    {
+        return pos;
+    }
+
+    //! \brief The total size of the input.
+    size_t size() const
+    {
+        return buffer.size();
+    }
+
+    //! \brief Skip all whitespace, including empty lines.
+    void skip_space()
+    {
+        while (!eof() && is_space(buffer[pos]))
+            ++pos;
+    }
+
+    /*!
+     * \brief Read the rest of the current line and move to the beginning of the next line.
+     * \return The line without the line break.
+     */
+    std::string_view read_line()
+    {
+        char const * const begin = buffer.data() + pos;
+        size_t const remaining = buffer.size() - pos;
+        void const * const newline = std::memchr(begin, '\n', remaining);
+        size_t const length = newline ? static_cast<char const *>(newline) - begin : remaining;
+        pos += newline ? length + 1 : length;
+        return std::string_view{begin, length};
+    }
+};
+
+/*!
+ * \brief Lookup tables for converting alignment characters, computed at compile time.
+ * \tparam alphabet_type The alphabet type of the sequences.
+ */
+template<seqan3::alphabet alphabet_type>
+struct AlignmentCharTable
+{
+    //! \brief The alphabet that decides whether a character is legal.
+    using legal_alphabet_type = std::conditional_t<seqan3::nucleotide_alphabet<alphabet_type>,
+                                                   seqan3::rna15,
+                                                   seqan3::aa27>;
+
+    //! \brief The character classes.
+    enum CharClass : uint8_t
+    {
+        illegal, //!< A character that is not allowed in the alignment.
+        letter,  //!< A gap or a character of the legal alphabet.
+        digit    //!< A position number, which is skipped.
+    };
+
+    //! \brief The class of each character.
+    static constexpr std::array<uint8_t, 256> classes = [] ()
+    {
+        std::array<uint8_t, 256> result{};
+        for (size_t idx = 0; idx < result.size(); ++idx)
+        {
+            char const chr = static_cast<char>(idx);
+            if (chr >= '0' && chr <= '9')
+                result[idx] = digit;
+            else if (seqan3::char_is_valid_for<seqan3::gapped<legal_alphabet_type>>(chr))
+                result[idx] = letter;
+            else
+                result[idx] = illegal;
+        }
+        return result;
+    }();
+
+    //! \brief The alphabet representation of each character.
+    static constexpr std::array<seqan3::gapped<alphabet_type>, 256> letters = [] ()
+    {
+        std::array<seqan3::gapped<alphabet_type>, 256> result{};
+        for (size_t idx = 0; idx < result.size(); ++idx)
+            seqan3::assign_char_to(static_cast<char>(idx), result[idx]);
+        return result;
+    }();
+};
+
+/*!
+ * \brief Validate a word of alignment characters and append it to a row of the alignment.
+ * \tparam alphabet_type The alphabet type of the sequences.
+ * \param[in] word The characters to be appended. Digits are skipped.
+ * \param[in,out] row The alignment row.
+ * \throws seqan3::parse_error if the word contains an illegal character.
+ */
+template<seqan3::alphabet alphabet_type>
+void append_alignment_row(std::string_view word, std::vector<seqan3::gapped<alphabet_type>> & row)
+{
+    using table = AlignmentCharTable<alphabet_type>;
+
+    // Validate the whole word in a single branch-free pass, so that the common case needs no checks below.
+    bool illegal_found = false;
+    for (char chr : word)
+        illegal_found |= table::classes[static_cast<unsigned char>(chr)] == table::illegal;
+
+    if (illegal_found)
+    {
+        for (char chr : word)
+        {
+            if (table::classes[static_cast<unsigned char>(chr)] == table::illegal)
+            {
+                using legal_alphabet_type = typename table::legal_alphabet_type;
+                throw seqan3::parse_error{"Encountered an unexpected letter: char_is_valid_for<" +
+                                          seqan3::detail::type_name_as_string<legal_alphabet_type> +
+                                          "> evaluated to false on " + seqan3::detail::make_printable(chr)};
+            }
+        }
+    }
+
+    for (char chr : word)
+        if (table::classes[static_cast<unsigned char>(chr)] == table::letter)
+            row.push_back(table::letters[static_cast<unsigned char>(chr)]);
+}
+
+/*!
+ * \brief Reserve the expected length for each alignment row, after the first block has been read.
+ * \tparam alphabet_type The alphabet type of the sequences.
+ * \param[in,out] sequences The alignment rows.
+ * \param[in] block_bytes The number of bytes that the first block occupies in the input.
+ * \param[in] total_bytes The number of bytes of all blocks in the input.
+ */
+template<seqan3::alphabet alphabet_type>
+void reserve_alignment_rows(std::vector<std::vector<seqan3::gapped<alphabet_type>>> & sequences,
+                            size_t block_bytes,
+                            size_t total_bytes)
+{
+    if (sequences.empty() || block_bytes == 0)
+        return;
+
+    size_t const expected_length = sequences.front().size() * (total_bytes / block_bytes + 1);
+    for (auto & row : sequences)
+        row.reserve(expected_length);
+}
+
+} // namespace mars
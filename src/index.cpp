@@ -5,118 +5,440 @@
 // shipped with this file and also available at https://github.com/seqan/mars.
 // ------------------------------------------------------------------------------------------------------------
 
+#include <seqan3/std/algorithm>
+#include <seqan3/std/iterator>
+#include <cctype>
+#include <random>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <seqan3/alphabet/nucleotide/dna15.hpp>
+#include <seqan3/alphabet/views/char_to.hpp>
 #include <seqan3/io/sequence_file/input.hpp>
 
 #ifdef SEQAN3_HAS_ZLIB
     #include <seqan3/contrib/stream/gz_istream.hpp>
-    #include <seqan3/contrib/stream/gz_ostream.hpp>
 #endif
 
+#include "block_file.hpp"
 #include "index.hpp"
+#include "numa.hpp"
+#include "phase_report.hpp"
+#include "sequence_reader.hpp"
 #include "settings.hpp"
+#include "thread_budget.hpp"
+#include "trace.hpp"
 
 namespace mars
 {
 
-void BiDirectionalIndex::read_genome(std::vector<seqan3::dna4_vector> & seqs)
+void BiDirectionalIndex::read_genome(std::filesystem::path const & filepath,
+                                     PackedText & text,
+                                     ContentHash * hash)
 {
-    struct dna4_traits : seqan3::sequence_file_input_default_traits_dna
+    size_t const first = text.sequence_count();
+    if (!read_sequences_parallel(filepath, text, names))
     {
-        using sequence_alphabet = seqan3::dna4;
-    };
-    using fields = seqan3::fields<seqan3::field::seq, seqan3::field::id>;
-    using SeqFileInput = seqan3::sequence_file_input<dna4_traits, fields>;
+        struct dna4_traits : seqan3::sequence_file_input_default_traits_dna
+        {
+            using sequence_alphabet = seqan3::dna4;
+        };
+        using fields = seqan3::fields<seqan3::field::seq, seqan3::field::id>;
+        using SeqFileInput = seqan3::sequence_file_input<dna4_traits, fields>;
 
-    auto parse = [this, &seqs] (auto && reader)
-    {
-        reader.options.truncate_ids = true;
+        auto parse = [this, &text] (auto && reader)
+        {
+            reader.options.truncate_ids = true;
+
+            for (auto & [seq, name] : reader)
+            {
+                text.push_back(seq);
+                names.push_back(std::move(name));
+            }
+        };
 
-        for (auto & [seq, name] : reader)
+        try
         {
-            seqs.push_back(std::move(seq));
-            names.push_back(std::move(name));
+            SeqFileInput reader{filepath};
+            parse(reader);
         }
-    };
+        catch (std::invalid_argument & e)
+        {
+            logger(1, "Could not interpret the file suffix " << filepath.extension()
+                      << ", trying to parse fasta." << std::endl);
+            std::ifstream ifs{filepath};
+            if (ifs)
+            {
+                SeqFileInput reader{ifs, seqan3::format_fasta()};
+                parse(reader);
+            }
+            ifs.close();
+        }
+    }
 
-    try
+    if (hash != nullptr)
     {
-        SeqFileInput reader{settings.genome_file};
-        parse(reader);
-        return;
+        for (size_t idx = first; idx < text.sequence_count(); ++idx)
+        {
+            hash->update(names[names.size() - text.sequence_count() + idx]);
+            hash->update(text.sequence(idx));
+        }
+    }
+}
+
+//! \brief A stream buffer that collects the written data in a string.
+struct StringBuffer : public std::streambuf
+{
+    std::string data{};
+
+    int_type overflow(int_type chr) override
+    {
+        if (!traits_type::eq_int_type(chr, traits_type::eof()))
+            data.push_back(traits_type::to_char_type(chr));
+        return chr;
     }
-    catch (std::invalid_argument & e)
+
+    std::streamsize xsputn(char const * str, std::streamsize num) override
     {
-        logger(1, "Could not interpret the file suffix " << settings.genome_file.extension()
-                  << ", trying to parse fasta." << std::endl);
+        data.append(str, static_cast<size_t>(num));
+        return num;
     }
-    std::ifstream ifs{settings.genome_file};
-    if (ifs)
+};
+
+//! \brief A stream buffer that reads from a string without copying it.
+struct MemoryBuffer : public std::streambuf
+{
+    explicit MemoryBuffer(std::string & data)
     {
-        SeqFileInput reader{ifs, seqan3::format_fasta()};
-        parse(reader);
+        setg(data.data(), data.data(), data.data() + data.size());
     }
-    ifs.close();
+};
+
+/*!
+ * \brief Serialize an object with cereal into a string.
+ * \param object The object to be archived.
+ * \return the binary archive.
+ */
+template <typename object_t>
+static std::string archive_to_string(object_t const & object)
+{
+    StringBuffer buffer{};
+    {
+        std::ostream stream{&buffer};
+        cereal::BinaryOutputArchive oarchive{stream};
+        oarchive(object);
+    }
+    return std::move(buffer.data);
 }
 
-void BiDirectionalIndex::write_index(std::filesystem::path & indexpath)
+/*!
+ * \brief Deserialize an object with cereal from a string.
+ * \param data The binary archive.
+ * \param[out] object The object to be restored.
+ */
+template <typename object_t>
+static void archive_from_string(std::string & data, object_t & object)
 {
-#ifdef SEQAN3_HAS_ZLIB
-    if (settings.compress_index)
+    MemoryBuffer buffer{data};
+    std::istream stream{&buffer};
+    cereal::BinaryInputArchive iarchive{stream};
+    iarchive(object);
+}
+
+//! \brief Segments with fewer characters keep their sequences, such that they can be merged later.
+static constexpr size_t small_segment_length{1ul << 26};
+
+//! \brief The number of small segments that triggers their compaction.
+static constexpr size_t compaction_threshold{4};
+
+//! \brief The version string of the first segment, which is compatible with unsegmented indices.
+static std::string const index_version{"1 mars bi_fm_index<dna4,collection>\n"};
+
+/*!
+ * \brief The version string of further segments, which additionally contain the sequences of small segments.
+ * \details Version 2 stored these sequences as strings, version 3 stores them as a packed text.
+ */
+static std::string const segment_version{"3 mars bi_fm_index<dna4,collection> segment\n"};
+
+/*!
+ * \brief Convert the sequences of a version 2 segment into a packed text.
+ * \param texts The sequences as strings.
+ * \return the packed sequences.
+ */
+static PackedText pack_texts(std::vector<std::string> const & texts)
+{
+    PackedText text{};
+    for (std::string const & str : texts)
+        text.push_back(str | seqan3::views::char_to<seqan3::dna4>);
+    return text;
+}
+
+/*!
+ * \brief The file of an index segment.
+ * \param sidx The number of the segment.
+ * \return `genome_file.marsindex` for the first segment and `genome_file.marsindex.<sidx>` for the others.
+ */
+static std::filesystem::path segment_path(size_t sidx)
+{
+    std::filesystem::path indexpath = settings.genome_file;
+    indexpath += ".marsindex";
+    if (sidx > 0)
+        indexpath += "." + std::to_string(sidx);
+    return indexpath;
+}
+
+/*!
+ * \brief The journal of a compaction, which lists the replaced segment files.
+ * \details The compaction is committed when the journal is renamed into place. The merged segment is then renamed
+ * into the first listed file and the other listed files are removed, which can be completed by any later process.
+ */
+static std::filesystem::path compaction_journal_path()
+{
+    std::filesystem::path journalpath = segment_path(0);
+    journalpath += ".compaction";
+    return journalpath;
+}
+
+//! \brief The file that receives the merged segment before the compaction is committed.
+static std::filesystem::path compaction_merged_path()
+{
+    std::filesystem::path mergedpath = segment_path(0);
+    mergedpath += ".compact";
+    return mergedpath;
+}
+
+//! \brief Complete a committed compaction, which may have been interrupted or is being completed concurrently.
+static void finish_compaction()
+{
+    std::filesystem::path const journalpath = compaction_journal_path();
+    std::vector<size_t> files{};
+    {
+        std::ifstream ifs{journalpath};
+        if (!ifs)
+            return;
+        for (size_t num{}; ifs >> num;)
+            files.push_back(num);
+    }
+
+    // Each step is skipped if it has been done before, thus errors are expected and ignored.
+    std::error_code error{};
+    if (!files.empty())
+    {
+        std::filesystem::rename(compaction_merged_path(), segment_path(files.front()), error);
+        for (size_t idx = 1; idx < files.size(); ++idx)
+            std::filesystem::remove(segment_path(files[idx]), error);
+    }
+    std::filesystem::remove(journalpath, error);
+}
+
+/*!
+ * \brief Find the files of further segments on disk, after completing a committed compaction.
+ * \return the numbers of the segment files in ascending order, which may have gaps after a compaction.
+ */
+static std::vector<size_t> segment_numbers()
+{
+    std::filesystem::path const firstpath = segment_path(0);
+    std::string const prefix = firstpath.filename().string() + ".";
+    std::filesystem::path const directory = firstpath.has_parent_path() ? firstpath.parent_path() : ".";
+    std::vector<size_t> numbers{};
+    do
     {
-        indexpath += ".gz";
-        std::ofstream ofs{indexpath, std::ios::binary};
-        if (ofs)
+        finish_compaction();
+        numbers.clear();
+        std::error_code error{};
+        for (auto const & entry : std::filesystem::directory_iterator{directory, error})
         {
-            // Write the index to disk, including a version string.
-            seqan3::contrib::gz_ostream gzstream(ofs);
-            cereal::BinaryOutputArchive oarchive{gzstream};
-            std::string const version{"1 mars bi_fm_index<dna4,collection>\n"};
-            oarchive(version);
-            oarchive(index);
-            oarchive(names);
-            gzstream.flush();
+            std::string const name = entry.path().filename().string();
+            auto const is_digit = [] (unsigned char chr) { return std::isdigit(chr) != 0; };
+            if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+                std::all_of(name.begin() + prefix.size(), name.end(), is_digit))
+                numbers.push_back(std::stoul(name.substr(prefix.size())));
         }
-        ofs.close();
     }
-    else
-#endif
+    while (std::filesystem::exists(compaction_journal_path())); // another process has committed a compaction
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+/*!
+ * \brief Flush a file or directory to the disk, such that it is complete after a crash of the system.
+ * \param filepath The file, or the directory whose entries have been renamed.
+ * \throws seqan3::file_open_error if the file cannot be flushed.
+ */
+static void sync_file(std::filesystem::path const & filepath)
+{
+    int const fd = ::open(filepath.c_str(), O_RDONLY);
+    bool const success = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0)
+        ::close(fd);
+    if (!success)
+        throw seqan3::file_open_error{"Could not flush the file to the disk ==> " + filepath.string()};
+}
+
+/*!
+ * \brief Archive an index segment and store it in a file on disk.
+ * \param indexpath The path of the index output file.
+ * \param segment The segment to be stored.
+ * \param segment_names The names of the sequences in the segment.
+ * \param first Whether this is the first segment, which is stored in the format of unsegmented indices.
+ * \return the archived size of the index in bytes.
+ * \throws seqan3::file_open_error if the file cannot be written completely, in which case it is removed.
+ */
+static size_t write_segment(std::filesystem::path const & indexpath,
+                          IndexSegment const & segment,
+                          std::vector<std::string> const & segment_names,
+                          bool first)
+{
+    std::string const & version = first ? index_version : segment_version;
+    size_t index_bytes{0};
+    try
     {
-        std::ofstream ofs{indexpath, std::ios::binary};
-        if (ofs)
+        if (settings.compress_index)
+        {
+            // Write the components separately into a block-compressed container, which is compressed in parallel.
+            BlockFileWriter writer{};
+            writer.add("version", version);
+            std::string data = archive_to_string(segment.index);
+            index_bytes = data.size();
+            writer.add("index", std::move(data));
+            writer.add("names", archive_to_string(segment_names));
+            if (!first)
+                writer.add("text", archive_to_string(segment.text));
+            writer.write(indexpath);
+        }
+        else
         {
-            // Write the index to disk, including a version string.
-            cereal::BinaryOutputArchive oarchive{ofs};
-            std::string const version{"1 mars bi_fm_index<dna4,collection>\n"};
-            oarchive(version);
-            oarchive(index);
-            oarchive(names);
+            std::ofstream ofs{indexpath, std::ios::binary};
+            if (!ofs)
+                throw seqan3::file_open_error{"Could not write the index ==> " + indexpath.string()};
+            {
+                // Write the index to disk, including a version string.
+                cereal::BinaryOutputArchive oarchive{ofs};
+                oarchive(version);
+                std::streamoff const start = ofs.tellp();
+                oarchive(segment.index);
+                index_bytes = static_cast<size_t>(ofs.tellp() - start);
+                oarchive(segment_names);
+                if (!first)
+                    oarchive(segment.text);
+            }
+            ofs.close();
+            if (!ofs)
+                throw seqan3::file_open_error{"Could not write the index ==> " + indexpath.string()};
         }
-        ofs.close();
+        sync_file(indexpath);
+    }
+    catch (...)
+    {
+        // A partial file must not be mistaken for an index.
+        std::error_code error{};
+        std::filesystem::remove(indexpath, error);
+        throw;
     }
+    return index_bytes;
+}
+
+/*!
+ * \brief Split sequences into parts of similar length at the sequence boundaries.
+ * \param text The sequences.
+ * \param count The number of parts, which is reduced to the number of sequences.
+ * \return the number of the first sequence of each part, followed by the number of sequences.
+ */
+static std::vector<size_t> segment_bounds(PackedText const & text, size_t count)
+{
+    // Split at the sequence boundaries that are closest to equal shares of the total length.
+    std::vector<size_t> bounds{0};
+    for (size_t part = 1; part < count; ++part)
+    {
+        size_t idx = bounds.back() + 1;
+        while (idx < text.sequence_count() && text.sequence_begin(idx) < text.size() * part / count)
+            ++idx;
+        if (idx >= text.sequence_count())
+            break;
+        bounds.push_back(idx);
+    }
+    bounds.push_back(text.sequence_count());
+    return bounds;
+}
+
+void BiDirectionalIndex::add_segment(PackedText && text, bool mergeable)
+{
+    IndexSegment & segment = segments.emplace_back();
+    segment.index = Index{text.sequences()};
+    segment.first_sequence = names.size() - text.sequence_count();
+    segment.sequence_count = text.sequence_count();
+    if (mergeable && segments.size() > 1 && text.size() < small_segment_length)
+        segment.text = std::move(text);
+}
+
+void BiDirectionalIndex::write_index(std::filesystem::path const & indexpath, size_t sidx)
+{
+    IndexSegment & segment = segments[sidx];
+    std::vector<std::string> const segment_names(names.cbegin() + segment.first_sequence,
+                                                 names.cbegin() + segment.first_sequence + segment.sequence_count);
+    segment.index_bytes = write_segment(indexpath, segment, segment_names, sidx == 0);
 }
 
 bool BiDirectionalIndex::read_index(std::filesystem::path & indexpath)
 {
+    IndexSegment segment{{}, names.size(), 0, {}, 0};
+    std::vector<std::string> segment_names{};
+    std::string version{};
     bool success = false;
-    if (std::filesystem::exists(indexpath))
+    if (std::filesystem::exists(indexpath) && BlockFileReader::is_block_file(indexpath))
+    {
+        // Each component is inflated in parallel.
+        BlockFileReader const reader{indexpath};
+        version = reader.read("version");
+        std::string data = reader.read("index");
+        segment.index_bytes = data.size();
+        archive_from_string(data, segment.index);
+        data = reader.read("names");
+        archive_from_string(data, segment_names);
+        if (version[0] == '2')
+        {
+            std::vector<std::string> texts{};
+            data = reader.read("texts");
+            archive_from_string(data, texts);
+            segment.text = pack_texts(texts);
+        }
+        else if (version[0] == '3')
+        {
+            data = reader.read("text");
+            archive_from_string(data, segment.text);
+        }
+        success = true;
+    }
+    else if (std::filesystem::exists(indexpath))
     {
         std::ifstream ifs{indexpath, std::ios::binary};
         if (ifs.good())
         {
             cereal::BinaryInputArchive iarchive{ifs};
-            std::string version;
             iarchive(version);
-            assert(version[0] == '1');
-            iarchive(index);
-            iarchive(names);
+            std::streamoff const start = ifs.tellg();
+            iarchive(segment.index);
+            segment.index_bytes = static_cast<size_t>(ifs.tellg() - start);
+            iarchive(segment_names);
+            if (version[0] == '2')
+            {
+                std::vector<std::string> texts{};
+                iarchive(texts);
+                segment.text = pack_texts(texts);
+            }
+            else if (version[0] == '3')
+            {
+                iarchive(segment.text);
+            }
             success = true;
         }
         ifs.close();
     }
 #ifdef SEQAN3_HAS_ZLIB
-    if (!success)
+    if (!success && segments.empty())
     {
+        // Indices that have been written as a single gzip stream by earlier versions of MaRs.
         std::filesystem::path gzindexpath = indexpath;
         gzindexpath += ".gz";
         if (std::filesystem::exists(gzindexpath))
@@ -126,11 +448,9 @@ bool BiDirectionalIndex::read_index(std::filesystem::path & indexpath)
             {
                 seqan3::contrib::gz_istream gzstream(ifs);
                 cereal::BinaryInputArchive iarchive{gzstream};
-                std::string version;
                 iarchive(version);
-                assert(version[0] == '1');
-                iarchive(index);
-                iarchive(names);
+                iarchive(segment.index);
+                iarchive(segment_names);
                 success = true;
                 indexpath = gzindexpath;
             }
@@ -138,36 +458,465 @@ bool BiDirectionalIndex::read_index(std::filesystem::path & indexpath)
         }
     }
 #endif
+    if (success)
+    {
+        assert(version[0] >= '1' && version[0] <= '3');
+        segment.sequence_count = segment_names.size();
+        names.insert(names.end(), std::make_move_iterator(segment_names.begin()),
+                     std::make_move_iterator(segment_names.end()));
+        segments.push_back(std::move(segment));
+    }
     return success;
 }
 
+void BiDirectionalIndex::start_compaction()
+{
+    std::vector<size_t> small_segments{};
+    for (size_t sidx = 1; sidx < segments.size(); ++sidx)
+        if (segments[sidx].text.sequence_count() > 0)
+            small_segments.push_back(sidx);
+    if (small_segments.size() < compaction_threshold)
+        return;
+
+    // The segments are not modified while the search is running, thus the task can read them.
+    auto task = [this, small_segments] ()
+    {
+        TraceScope const trace{"compact segments"};
+        ThreadBudget::Reservation const threads = thread_budget.reserve(1);
+
+        IndexSegment merged{};
+        std::vector<std::string> merged_names{};
+        for (size_t sidx : small_segments)
+        {
+            IndexSegment const & segment = segments[sidx];
+            for (size_t idx = 0; idx < segment.sequence_count; ++idx)
+            {
+                merged.text.push_back(segment.text.sequence(idx));
+                merged_names.push_back(names[segment.first_sequence + idx]);
+            }
+        }
+        merged.index = Index{merged.text.sequences()};
+        merged.sequence_count = merged.text.sequence_count();
+        // The merged segment becomes a regular segment if it is large enough.
+        if (merged.text.size() >= small_segment_length)
+            merged.text = PackedText{};
+
+        // Write the merged segment, then commit the compaction with the journal of the replaced segment files,
+        // such that an interruption at any point leaves either the old or the new segments on disk.
+        // The journal is committed only after the merged segment and the journal have been synced to the disk.
+        std::filesystem::path const journalpath = compaction_journal_path();
+        std::filesystem::path journaltmp = journalpath;
+        journaltmp += ".tmp";
+        try
+        {
+            write_segment(compaction_merged_path(), merged, merged_names, false);
+            std::ofstream ofs{journaltmp};
+            for (size_t sidx : small_segments)
+                ofs << segment_files[sidx] << "\n";
+            ofs.close();
+            if (!ofs)
+                throw seqan3::file_open_error{"Could not write the file ==> " + journaltmp.string()};
+            sync_file(journaltmp);
+        }
+        catch (std::exception const & exception)
+        {
+            // The small segments remain valid, so the compaction is just skipped.
+            std::error_code error{};
+            std::filesystem::remove(compaction_merged_path(), error);
+            std::filesystem::remove(journaltmp, error);
+            logger(0, "Warning: The index segments are not compacted. " << exception.what() << std::endl);
+            return;
+        }
+        std::filesystem::rename(journaltmp, journalpath);
+        std::filesystem::path const directory = journalpath.parent_path();
+        sync_file(directory.empty() ? std::filesystem::path{"."} : directory);
+        finish_compaction();
+        logger(1, "Compacted " << small_segments.size() << " index segments ==> "
+                  << segment_path(segment_files[small_segments.front()]) << std::endl);
+    };
+
+    if (pool)
+        compaction = pool->submit(task);
+    else
+        task();
+}
+
+void BiDirectionalIndex::create_cached(std::filesystem::path const & filepath)
+{
+    if (!std::filesystem::exists(filepath))
+        throw seqan3::file_open_error{"Could not find the sequence file <== " + filepath.string()};
+
+    // The key covers the sequences, their names, and the index format.
+    PackedText text{};
+    ContentHash hash{};
+    hash.update(index_version);
+    size_t const names_before = names.size();
+    {
+        PhaseReport::Timer const timer = phase_report.measure("genome read");
+        read_genome(filepath, text, &hash);
+    }
+    logger(1, "Read " << text.sequence_count() << " sequences <== " << filepath << std::endl);
+    if (text.sequence_count() == 0)
+        return;
+
+    // The names are restored from the index, if it exists.
+    std::vector<std::string> seq_names(std::make_move_iterator(names.begin() + names_before),
+                                       std::make_move_iterator(names.end()));
+    names.resize(names_before);
+    std::filesystem::path indexpath = settings.index_cache / (hash.hex() + ".marsindex");
+    if (std::filesystem::exists(indexpath))
+    {
+        PhaseReport::Timer const timer = phase_report.measure("index load");
+        try
+        {
+            if (read_index(indexpath))
+            {
+                logger(1, "Using cached index <== " << indexpath << std::endl);
+                return;
+            }
+        }
+        catch (std::exception const & exception)
+        {
+            // A damaged entry is a cache miss, and it is replaced below.
+            logger(0, "Warning: Rebuilding the corrupt cached index " << indexpath << ". " << exception.what()
+                      << std::endl);
+        }
+    }
+
+    names.insert(names.end(), std::make_move_iterator(seq_names.begin()), std::make_move_iterator(seq_names.end()));
+    {
+        PhaseReport::Timer const timer = phase_report.measure("index build");
+        add_segment(std::move(text), false);
+    }
+    {
+        // Write to a unique temporary file and rename it, such that concurrent processes never see partial files.
+        PhaseReport::Timer const timer = phase_report.measure("index write");
+        std::filesystem::create_directories(settings.index_cache);
+        std::filesystem::path tmppath = indexpath;
+        tmppath += "." + std::to_string(std::random_device{}()) + ".tmp";
+        IndexSegment & segment = segments.back();
+        std::vector<std::string> const segment_names(names.cbegin() + segment.first_sequence, names.cend());
+        try
+        {
+            // The entry is published only after it has been written completely.
+            segment.index_bytes = write_segment(tmppath, segment, segment_names, true);
+            std::filesystem::rename(tmppath, indexpath);
+        }
+        catch (seqan3::file_open_error const & exception)
+        {
+            logger(0, "Warning: The index is not cached. " << exception.what() << std::endl);
+            return;
+        }
+    }
+    logger(1, "Created index ==> " << indexpath << std::endl);
+}
+
+size_t BiDirectionalIndex::count_segments()
+{
+    std::filesystem::path gzindexpath = segment_path(0);
+    gzindexpath += ".gz";
+    if (!std::filesystem::exists(segment_path(0)) && !std::filesystem::exists(gzindexpath))
+        return 0;
+    return 1 + segment_numbers().size();
+}
+
+void BiDirectionalIndex::create_segment_files(size_t count)
+{
+    TraceScope const trace{"create index"};
+    if (!std::filesystem::exists(settings.genome_file))
+        throw seqan3::file_open_error{"Could not find the genome file <== " + settings.genome_file.string()};
+
+    BiDirectionalIndex genome{};
+    PackedText text{};
+    {
+        PhaseReport::Timer const timer = phase_report.measure("genome read");
+        genome.read_genome(settings.genome_file, text);
+    }
+    logger(1, "Read " << text.sequence_count() << " genome sequences <== " << settings.genome_file << std::endl);
+    if (text.sequence_count() == 0)
+        return;
+
+    // Segment files without a first segment are left over from a removed index.
+    for (size_t num : segment_numbers())
+        std::filesystem::remove(segment_path(num));
+
+    // Only one segment is held in memory at a time. The first segment is written last, because it marks the index
+    // as complete.
+    PhaseReport::Timer const timer = phase_report.measure("index build");
+    std::vector<PackedText::Sequence> const sequences = text.sequences();
+    std::vector<size_t> const bounds = segment_bounds(text, count);
+    size_t const parts = bounds.size() - 1;
+    for (size_t step = 1; step <= parts; ++step)
+    {
+        size_t const part = step % parts;
+        IndexSegment segment{};
+        segment.index = Index{std::vector<PackedText::Sequence>(sequences.begin() + bounds[part],
+                                                                sequences.begin() + bounds[part + 1])};
+        segment.sequence_count = bounds[part + 1] - bounds[part];
+        std::vector<std::string> const segment_names(genome.names.cbegin() + bounds[part],
+                                                     genome.names.cbegin() + bounds[part + 1]);
+        try
+        {
+            write_segment(segment_path(part), segment, segment_names, part == 0);
+        }
+        catch (seqan3::file_open_error const &)
+        {
+            for (size_t num = 1; num < step; ++num)
+                std::filesystem::remove(segment_path(num));
+            throw;
+        }
+    }
+    logger(1, "Created index ==> " << segment_path(0) << " with " << parts << " segments" << std::endl);
+}
+
+void BiDirectionalIndex::append_segment_file()
+{
+    TraceScope const trace{"create index"};
+    BiDirectionalIndex update{};
+    PackedText text{};
+    {
+        PhaseReport::Timer const timer = phase_report.measure("genome read");
+        update.read_genome(settings.update_file, text);
+    }
+    logger(1, "Read " << text.sequence_count() << " new sequences <== " << settings.update_file << std::endl);
+    if (text.sequence_count() == 0)
+        return;
+
+    // The segment files are self-contained, thus the existing segments are not needed for the new one. A small
+    // segment keeps its sequences, such that a later run without workers can compact it.
+    std::vector<size_t> const numbers = segment_numbers();
+    std::filesystem::path const segmentpath = segment_path(numbers.empty() ? 1 : numbers.back() + 1);
+    IndexSegment segment{};
+    {
+        PhaseReport::Timer const timer = phase_report.measure("index build");
+        segment.index = Index{text.sequences()};
+    }
+    segment.sequence_count = text.sequence_count();
+    if (text.size() < small_segment_length)
+        segment.text = std::move(text);
+    {
+        PhaseReport::Timer const timer = phase_report.measure("index write");
+        write_segment(segmentpath, segment, update.names, false);
+    }
+    logger(1, "Added index segment ==> " << segmentpath << std::endl);
+}
+
+void BiDirectionalIndex::create_shard(size_t shard, size_t shard_count)
+{
+    TraceScope const trace{"create index"};
+    PhaseReport::Timer const timer = phase_report.measure("index load");
+    segment_files = segment_numbers();
+    segment_files.insert(segment_files.begin(), 0);
+    size_t const total = segment_files.size();
+    auto load = [this, shard, shard_count, total] ()
+    {
+        for (size_t sidx = shard * total / shard_count; sidx < (shard + 1) * total / shard_count; ++sidx)
+        {
+            std::filesystem::path indexpath = segment_path(segment_files[sidx]);
+            if (!read_index(indexpath))
+                throw seqan3::file_open_error{"Could not read the index segment <== " + indexpath.string()};
+        }
+        if (settings.numa == "replicate")
+            replicate();
+    };
+    // The main thread of a worker process is not pinned, thus the shards are loaded on alternating nodes by a
+    // pinned thread, which makes its node the home of the original index.
+    if (settings.numa == "replicate" && Numa::node_count() > 1)
+        Numa::run_on_node(shard % Numa::node_count(), load);
+    else
+        load();
+    logger(1, "Using " << segments.size() << " of " << total << " index segments as shard " << shard << std::endl);
+}
+
+size_t BiDirectionalIndex::text_length() const
+{
+    size_t length{0};
+    for (IndexSegment const & segment : segments)
+        length += segment.index.size() - (segment.sequence_count > 1 ? segment.sequence_count : 2);
+    return length;
+}
+
+void BiDirectionalIndex::replicate()
+{
+    if (Numa::node_count() < 2 || segments.empty())
+        return;
+
+    // Each copy is made by a thread on the target node, such that its pages are allocated there.
+    PhaseReport::Timer const timer = phase_report.measure("index replicate");
+    size_t const home = Numa::is_pinned() ? Numa::current_node() : Numa::node_count();
+    replicas.resize(Numa::node_count());
+    std::vector<std::future<void>> copies{};
+    for (size_t node = 0; node < replicas.size(); ++node)
+    {
+        if (node == home)
+            continue;
+        copies.push_back(std::async(std::launch::async, [this, node] ()
+        {
+            Numa::run_on_node(node, [this, node] ()
+            {
+                for (IndexSegment const & segment : segments)
+                    replicas[node].push_back(segment.index);
+            });
+        }));
+    }
+    for (auto & copy : copies)
+        copy.get();
+    logger(1, "Replicated the index on " << copies.size() << " further NUMA nodes." << std::endl);
+}
+
+Index const & BiDirectionalIndex::local_index(size_t sidx) const
+{
+    size_t const node = Numa::current_node();
+    if (node < replicas.size() && !replicas[node].empty())
+        return replicas[node][sidx];
+    return segments[sidx].index;
+}
+
+void BiDirectionalIndex::record_memory() const
+{
+    if (!phase_report.enabled())
+        return;
+
+    // Sum the sizes that are known without traversing the index: the archived segment indices, whose size is a
+    // close estimate of their size in memory, the packed texts, and the names.
+    size_t index_bytes{0};
+    size_t bytes{0};
+    for (IndexSegment const & segment : segments)
+    {
+        index_bytes += segment.index_bytes;
+        bytes += segment.text.memory_size();
+    }
+    for (std::string const & name : names)
+        bytes += sizeof(std::string) + name.capacity();
+    phase_report.add_memory("index", index_bytes + bytes);
+
+    // Each replica is a copy of all segment indices.
+    size_t const replica_count = std::count_if(replicas.begin(), replicas.end(),
+                                               [] (std::vector<Index> const & replica) { return !replica.empty(); });
+    if (replica_count > 0)
+        phase_report.add_memory("index replicas", replica_count * index_bytes);
+}
+
 void BiDirectionalIndex::create()
 {
     if (settings.genome_file.empty())
         return;
 
-    std::filesystem::path indexpath = settings.genome_file;
-    indexpath += ".marsindex";
+    TraceScope const trace{"create index"};
+
+    // The pages of the index that this thread allocates are spread over the NUMA nodes.
+    struct InterleaveScope
+    {
+        bool const enabled{settings.numa == "interleave"};
+
+        InterleaveScope()
+        {
+            if (enabled)
+                Numa::interleave_allocations(true);
+        }
+
+        ~InterleaveScope()
+        {
+            if (enabled)
+                Numa::interleave_allocations(false);
+        }
+    } const interleave{};
 
-    // Check whether an index already exists.
-    if (read_index(indexpath))
+    // Look up the genome and the update in the cache directory instead of next to the genome file.
+    if (!settings.index_cache.empty())
     {
-        logger(1, "Using existing index <== " << indexpath << std::endl);
+        create_cached(settings.genome_file);
+        if (!settings.update_file.empty() && !segments.empty())
+            create_cached(settings.update_file);
+        if (!segments.empty() && settings.numa == "replicate")
+            replicate();
+        if (!segments.empty())
+            record_memory();
         return;
     }
 
-    // No index found: read genome and create an index.
-    if (std::filesystem::exists(settings.genome_file))
+    std::filesystem::path indexpath = segment_path(0);
+
+    // Check whether an index already exists, and read all of its segments. If another process compacts the
+    // segments meanwhile, which is detected by its journal or changed files, the segments are read again.
+    bool loaded{false};
+    {
+        PhaseReport::Timer const timer = phase_report.measure("index load");
+        for (size_t attempt = 0; attempt < 3; ++attempt)
+        {
+            segments.clear();
+            names.clear();
+            segment_files = segment_numbers();
+            segment_files.insert(segment_files.begin(), 0);
+            indexpath = segment_path(0);
+            loaded = read_index(indexpath);
+            if (!loaded)
+                break;
+            for (size_t sidx = 1; loaded && sidx < segment_files.size(); ++sidx)
+            {
+                std::filesystem::path segmentpath = segment_path(segment_files[sidx]);
+                loaded = read_index(segmentpath);
+            }
+            std::vector<size_t> const numbers = segment_numbers();
+            if (loaded && std::equal(numbers.begin(), numbers.end(), segment_files.begin() + 1, segment_files.end()))
+                break;
+            loaded = false;
+        }
+        if (!loaded && !segments.empty())
+            throw seqan3::file_open_error{"Could not read the index segments of " + indexpath.string()};
+    }
+    if (loaded)
+    {
+        logger(1, "Using existing index <== " << indexpath);
+        if (segments.size() > 1)
+            logger(1, " with " << segments.size() << " segments");
+        logger(1, std::endl);
+    }
+    else if (std::filesystem::exists(settings.genome_file)) // No index found: read genome and create an index.
     {
-        std::vector<seqan3::dna4_vector> seqs{};
-        read_genome(seqs);
-        logger(1, "Read " << seqs.size() << " genome sequences <== " << settings.genome_file << std::endl);
-        if (!seqs.empty())
+        PackedText text{};
+        {
+            PhaseReport::Timer const timer = phase_report.measure("genome read");
+            read_genome(settings.genome_file, text);
+        }
+        logger(1, "Read " << text.sequence_count() << " genome sequences <== " << settings.genome_file << std::endl);
+        if (text.sequence_count() > 0)
         {
             // Generate the BiFM index.
-            index = Index{seqs};
-            write_index(indexpath);
-            logger(1, "Created index ==> " << indexpath << std::endl);
+            {
+                PhaseReport::Timer const timer = phase_report.measure("index build");
+                add_segment(std::move(text));
+            }
+            {
+                // Segment files without a first segment are left over from a removed index.
+                PhaseReport::Timer const timer = phase_report.measure("index write");
+                for (size_t num : segment_numbers())
+                    std::filesystem::remove(segment_path(num));
+                segment_files.clear();
+                try
+                {
+                    for (size_t sidx = 0; sidx < segments.size(); ++sidx)
+                    {
+                        segment_files.push_back(sidx);
+                        write_index(segment_path(sidx), sidx);
+                    }
+                }
+                catch (seqan3::file_open_error const & exception)
+                {
+                    // An incomplete set of segments must not be loaded later, but the search can go on.
+                    for (size_t num : segment_files)
+                        std::filesystem::remove(segment_path(num));
+                    segment_files.clear();
+                    logger(0, "Warning: The index is not stored. " << exception.what() << std::endl);
+                }
+            }
+            if (!segment_files.empty())
+            {
+                logger(1, "Created index ==> " << indexpath);
+                if (segments.size() > 1)
+                    logger(1, " with " << segments.size() << " segments");
+                logger(1, std::endl);
+            }
         }
     }
     else
@@ -180,6 +929,51 @@ void BiDirectionalIndex::create()
         err_msg << "]";
         throw seqan3::file_open_error(err_msg.str());
     }
+
+    // Add new sequences as a separate segment, without rebuilding the existing segments.
+    if (!settings.update_file.empty() && !segments.empty())
+    {
+        PackedText text{};
+        {
+            PhaseReport::Timer const timer = phase_report.measure("genome read");
+            read_genome(settings.update_file, text);
+        }
+        logger(1, "Read " << text.sequence_count() << " new sequences <== " << settings.update_file << std::endl);
+        if (text.sequence_count() > 0)
+        {
+            {
+                PhaseReport::Timer const timer = phase_report.measure("index build");
+                add_segment(std::move(text));
+            }
+            // The segment is stored only if the index it extends has been stored.
+            if (segment_files.size() + 1 == segments.size())
+            {
+                segment_files.push_back(segment_files.back() + 1);
+                std::filesystem::path segmentpath = segment_path(segment_files.back());
+                try
+                {
+                    PhaseReport::Timer const timer = phase_report.measure("index write");
+                    write_index(segmentpath, segments.size() - 1);
+                    logger(1, "Added index segment ==> " << segmentpath << std::endl);
+                }
+                catch (seqan3::file_open_error const & exception)
+                {
+                    segment_files.pop_back();
+                    logger(0, "Warning: The index segment is not stored. " << exception.what() << std::endl);
+                }
+            }
+        }
+    }
+
+    if (!segments.empty())
+    {
+        if (settings.numa == "replicate")
+            replicate();
+        record_memory();
+        // Only stored segments can be compacted.
+        if (segment_files.size() == segments.size())
+            start_compaction();
+    }
 }
 
 } // namespace mars
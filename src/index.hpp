@@ -8,62 +8,190 @@
 #pragma once
 
 #include <seqan3/std/filesystem>
+#include <future>
 #include <string>
 #include <vector>
 
 #include <seqan3/alphabet/nucleotide/dna4.hpp>
 #include <seqan3/search/fm_index/bi_fm_index.hpp>
 
+#include "content_hash.hpp"
+#include "packed_text.hpp"
+
 namespace mars
 {
 
 //! \brief The type of a bi-directional index over the 4-letter DNA alphabet.
 using Index = seqan3::bi_fm_index<seqan3::dna4, seqan3::text_layout::collection>;
 
-//! \brief Provides a bi-directional search step-by-step with backtracking.
+//! \brief A part of the genome index that covers consecutive sequences.
+struct IndexSegment
+{
+    Index index; //!< The index of the sequences.
+    size_t first_sequence; //!< The global number of the first sequence in the segment.
+    size_t sequence_count; //!< The number of sequences in the segment.
+    PackedText text; //!< The sequences of a small segment for compaction, empty otherwise.
+    size_t index_bytes; //!< The archived size of the index, which estimates its memory, or 0 if unknown.
+};
+
+/*!
+ * \brief Provides a bi-directional search step-by-step with backtracking.
+ *
+ * \details
+ * The index consists of one or more segments. The first segment is stored in `genome_file.marsindex` and
+ * further segments that have been added with the update option in `genome_file.marsindex.1`, `.2` and so on.
+ * Small segments keep their sequences, such that they can be merged in the background without the genome files.
+ * The merged segment replaces the file of the first small segment and the other files are removed, which is recorded
+ * in a journal beforehand, such that an interrupted compaction is completed when the index is read next.
+ */
 class BiDirectionalIndex
 {
 private:
-    //! \brief The index in which the search is performed.
-    Index index;
+    //! \brief The segments in which the search is performed.
+    std::vector<IndexSegment> segments;
 
-    //! \brief The names of the sequences in the index.
+    //! \brief The names of the sequences in all segments.
     std::vector<std::string> names;
 
+    //! \brief The numbers of the segment files, which may have gaps after a compaction.
+    std::vector<size_t> segment_files;
+
+    //! \brief The background task that merges small segments.
+    std::future<void> compaction;
+
+    //! \brief Copies of the segment indices for each NUMA node, empty for the node where the index was built.
+    std::vector<std::vector<Index>> replicas;
+
     /*!
      * \brief Read a FASTA file of sequences.
-     * \param[out] seqs The object where the sequences can be stored.
+     * \param[in] filepath The sequence file.
+     * \param[out] text The packed text where the sequences are appended.
+     * \param[in,out] hash If not null, the names and sequences are added to this hash.
      */
-    void read_genome(std::vector<seqan3::dna4_vector> & seqs);
+    void read_genome(std::filesystem::path const & filepath,
+                     PackedText & text,
+                     ContentHash * hash = nullptr);
 
     /*!
-     * \brief Archive an index and store it in a file on disk.
-     * \param[in,out] indexpath The path of the index output file.
+     * \brief Index sequences as a new segment, whose names have already been appended.
+     * \param text The sequences of the segment, which the index is constructed from without unpacking them.
+     * \param mergeable Whether a small segment keeps its sequences for a later compaction.
      */
-    void write_index(std::filesystem::path & indexpath);
+    void add_segment(PackedText && text, bool mergeable = true);
 
     /*!
-     * \brief Unarchive an index and read it from a file on disk.
-     * \param[in] indexpath The path of the index input file.
+     * \brief Archive a segment and store it in a file on disk.
+     * \param indexpath The path of the index output file.
+     * \param sidx The number of the segment.
+     */
+    void write_index(std::filesystem::path const & indexpath, size_t sidx);
+
+    /*!
+     * \brief Unarchive a segment from a file on disk and append it.
+     * \param[in,out] indexpath The path of the index input file.
      * \return whether an index could be parsed.
      */
     bool read_index(std::filesystem::path & indexpath);
 
+    //! \brief Merge the small segments in the background, if there are enough of them.
+    void start_compaction();
+
+    /*!
+     * \brief Load the index from the cache directory or create it there, using the content hash as the key.
+     * \param filepath The sequence file, whose index becomes the next segment.
+     * \throws seqan3::file_open_error if the sequence file does not exist.
+     */
+    void create_cached(std::filesystem::path const & filepath);
+
+    /*!
+     * \brief Copy the segment indices into the memory of the other NUMA nodes.
+     * \details The node of the calling thread keeps the original, which must have been loaded by this thread.
+     * If the thread is not pinned, the location of the original is unknown and every node receives a copy.
+     */
+    void replicate();
+
+    /*!
+     * \brief Record the memory size of the index in the phase report.
+     * \details The size of each segment index is estimated by its archived size, which is known from reading or
+     * writing the segment, such that the estimate does not need another pass over the index.
+     */
+    void record_memory() const;
+
 public:
+    BiDirectionalIndex() = default;
+    BiDirectionalIndex(BiDirectionalIndex const &) = delete;
+    BiDirectionalIndex & operator=(BiDirectionalIndex const &) = delete;
+
+    //! \brief Destructor that waits for the compaction of segments.
+    ~BiDirectionalIndex()
+    {
+        wait_for_compaction();
+    }
+
+    //! \brief Wait until the compaction of segments, which runs in the background after create(), has finished.
+    void wait_for_compaction()
+    {
+        if (compaction.valid())
+            compaction.wait();
+    }
+
     /*!
      * \brief Create an index of a genome.
-     * \throws seqan3::file_open_error if neither `genome_file` nor `genome_file.marsindex` exist.
+     * \throws seqan3::file_open_error if neither `genome_file` nor `genome_file.marsindex` exist, or if the segment
+     *         files cannot be read consistently.
      *
      * \details
      *
      * This function has two modes:
      *
-     * 1. If `genome_file.marsindex` exists: Read the already created index from this file.
+     * 1. If `genome_file.marsindex` exists: Read the already created index from this file, followed by the
+     *    segments in `genome_file.marsindex.1`, `.2` and so on, in the order of their numbers.
      * 2. Else if `genome_file` exists: Read sequences from this file, create an index
      *    and write the index to `genome_file.marsindex`.
+     *
+     * Afterwards the sequences of `update_file` are indexed and stored as a new segment, if the file is given.
+     *
+     * If `index_cache` is set, the indices of `genome_file` and `update_file` are instead looked up in and stored
+     * to the cache directory under the content hash of their sequences, and no compaction takes place.
+     *
+     * On machines with several NUMA nodes the index is replicated on each node or its pages are interleaved across
+     * the nodes, depending on the `numa` setting.
      */
     void create();
 
+    /*!
+     * \brief Count the segment files of the genome index on disk.
+     * \return the number of segment files, including `genome_file.marsindex`.
+     */
+    static size_t count_segments();
+
+    /*!
+     * \brief Index `genome_file` as segment files of similar length, without keeping the index in memory.
+     * \param count The number of segments, which is reduced to the number of sequences.
+     * \throws seqan3::file_open_error if `genome_file` does not exist or a segment file cannot be written.
+     * \details The segments are built, written and freed one after another, such that processes that load a
+     * share of the segments can search genomes whose index exceeds the memory of a single process.
+     */
+    static void create_segment_files(size_t count);
+
+    /*!
+     * \brief Index `update_file` as a new segment file of the existing index, without loading the index.
+     * \throws seqan3::file_open_error if the segment file cannot be written.
+     */
+    static void append_segment_file();
+
+    /*!
+     * \brief Load a contiguous share of the segment files, as one of several processes that search the index.
+     * \param shard The number of this share.
+     * \param shard_count The number of shares, among which the segments are distributed evenly.
+     * \throws seqan3::file_open_error if a segment file cannot be read.
+     *
+     * \details
+     * The sequences are numbered from 0 within the share, such that the shares are concatenated in order.
+     * No new segments are added and no compaction takes place.
+     */
+    void create_shard(size_t shard, size_t shard_count);
+
     /*!
      * \brief Access the sequence names.
      * \return the name vector of the sequences.
@@ -74,13 +202,35 @@ public:
     }
 
     /*!
-     * \brief Access the underlying bi-FM index.
-     * \return the raw index (without metadata).
+     * \brief Access the index segments.
+     * \return the segments, which cover the sequences in order.
      */
-    Index const & raw() const
+    std::vector<IndexSegment> const & get_segments() const
     {
-        return index;
+        return segments;
     }
+
+    /*!
+     * \brief Access the index of a segment in the memory of the calling thread's NUMA node.
+     * \param sidx The number of the segment.
+     * \return the local replica if there is one, and the segment index otherwise.
+     */
+    Index const & local_index(size_t sidx) const;
+
+    /*!
+     * \brief Check whether the index contains sequences.
+     * \return true if there are no sequences.
+     */
+    bool empty() const
+    {
+        return names.empty();
+    }
+
+    /*!
+     * \brief The total length of all sequences.
+     * \return the number of indexed characters, without delimiters.
+     */
+    size_t text_length() const;
 };
 
 } // namespace mars
@@ -5,10 +5,11 @@
 // shipped with this file and also available at https://github.com/seqan/mars.
 // ------------------------------------------------------------------------------------------------------------
 
-#include <iomanip>
+#include <algorithm>
 #include <fstream>
 
 #include "location.hpp"
+#include "result_writer.hpp"
 #include "settings.hpp"
 
 namespace mars
@@ -39,40 +40,47 @@ void MotifLocationStore::push(MotifLocation && loc)
 
 void MotifLocationStore::print(std::ostream & out)
 {
-    out << std::left << std::setw(35) << "sequence name"
-        << "\t" << "index"
-        << "\t" << "pos"
-        << "\t" << "end"
-        << "\t" << "qlen"
-        << "\t" << "n"
-        << "\t" << "score"
-        << "\t" << "e-value"
-        << std::endl;
-
     std::lock_guard<std::mutex> guard(mutex_locations);
-    if (empty())
-        return;
+    ResultWriter writer{out, result_format(settings.result_file), names};
+    auto const stop = cbegin() + reported_count();
+    for (auto iter = cbegin(); iter != stop; ++iter)
+        writer.write(*iter);
+    writer.close();
+}
+
+double MotifLocationStore::evalue_threshold(double best_evalue)
+{
+    return std::max(std::sqrt(best_evalue) * 10, 1e-10);
+}
+
+size_t MotifLocationStore::reported_count() const
+{
+    if (empty() || !std::isnan(settings.score_filter))
+        return size();
 
-    auto iter = cbegin();
-    double const thr = std::max(std::sqrt(iter->evalue) * 10, 1e-10);
-    do
+    double const thr = evalue_threshold(front().evalue);
+    auto const stop = std::find_if(cbegin() + 1, cend(), [thr] (MotifLocation const & loc)
     {
-        out << std::left << std::setw(35) << names[iter->sequence]
-            << "\t" << iter->sequence
-            << "\t" << iter->position_start
-            << "\t" << iter->position_end
-            << "\t" << iter->query_length
-            << "\t" << +iter->num_stemloops
-            << "\t" << iter->score
-            << "\t" << iter->evalue
-            << std::endl;
-    }
-    while (++iter != cend() && (!std::isnan(settings.score_filter) || iter->evalue < thr));
+        return loc.evalue >= thr;
+    });
+    return stop - cbegin();
 }
 
 void MotifLocationStore::print()
 {
-    std::sort(begin(), end());
+    // Only the reported locations must be in order, thus we move them to the front and sort just those.
+    auto stop = end();
+    if (!empty() && std::isnan(settings.score_filter))
+    {
+        std::iter_swap(begin(), std::min_element(begin(), end()));
+        double const thr = evalue_threshold(front().evalue);
+        stop = std::partition(begin() + 1, end(), [thr] (MotifLocation const & loc)
+        {
+            return loc.evalue < thr;
+        });
+    }
+    std::sort(begin(), stop);
+
     if (!settings.result_file.empty())
     {
         logger(1, "Writing the best of " << size() << " results ==> " << settings.result_file << std::endl);
@@ -104,4 +112,12 @@ std::vector<StemloopHit> & StemloopHitStore::get(size_t seq)
     return hits[seq];
 }
 
+size_t StemloopHitStore::memory_size() const
+{
+    size_t bytes = hits.capacity() * sizeof(std::vector<StemloopHit>);
+    for (auto const & hitvec : hits)
+        bytes += hitvec.capacity() * sizeof(StemloopHit);
+    return bytes;
+}
+
 } // namespace mars
@@ -47,7 +47,14 @@ private:
     std::mutex mutex_locations;
 
     /*!
-     * \brief Print the collected motifs, preceeded by a header line.
+     * \brief The e-value threshold for reporting locations.
+     * \param best_evalue The e-value of the best location.
+     * \return The e-value that a location must fall below to be reported.
+     */
+    static double evalue_threshold(double best_evalue);
+
+    /*!
+     * \brief Print the reported locations in the format that the output file extension determines.
      * \param out The output stream.
      */
     void print(std::ostream & out);
@@ -59,9 +66,18 @@ public:
      */
     explicit MotifLocationStore(std::vector<std::string> const & names) : names{names} {}
 
-    //! \brief Sort all the locations and print them in order.
+    /*!
+     * \brief Sort the reported locations and print them in order.
+     * \details Only the reported prefix of the locations is sorted, the remaining locations are left unordered.
+     */
     void print();
 
+    /*!
+     * \brief The number of locations that are printed, i.e. the best locations that pass the e-value threshold.
+     * \return The length of the reported prefix, which requires that the locations are sorted.
+     */
+    size_t reported_count() const;
+
     /*!
      * \brief Add a location to the collection.
      * \param loc The location to be stored.
@@ -113,6 +129,12 @@ public:
      * \return a reference to the specified hit vector.
      */
     std::vector<StemloopHit> & get(size_t seq);
+
+    /*!
+     * \brief The allocated memory of the hit storage.
+     * \return the size in bytes.
+     */
+    size_t memory_size() const;
 };
 
 } // namespace mars
@@ -6,10 +6,17 @@
 // ------------------------------------------------------------------------------------------------------------
 
 #include <chrono>
+#include <future>
+#include <memory>
 #include <vector>
 
+#include "calibration.hpp"
+#include "phase_report.hpp"
 #include "search.hpp"
 #include "settings.hpp"
+#include "shard_search.hpp"
+#include "thread_budget.hpp"
+#include "trace.hpp"
 
 int main(int argc, char ** argv)
 {
@@ -19,19 +26,45 @@ int main(int argc, char ** argv)
     if (!mars::settings.parse_arguments(argc, argv))
         return EXIT_FAILURE;
 
-    // Start reading the genome and creating the index asyncronously
+    // Search a share of the index on behalf of a coordinator process
+    if (mars::settings.shard_count > 0)
+    {
+        mars::search_shard();
+        return 0;
+    }
+    mars::PhaseReport::Timer total_timer = mars::phase_report.measure("total");
+
+    // Start reading the genome and creating the index asyncronously, unless worker processes search it.
+    // The threads of both start phases are reserved before any of them runs: one for the index task and the
+    // remaining ones for folding, such that the scheduling order cannot oversubscribe the machine.
     mars::BiDirectionalIndex index{};
-    auto future_index = mars::pool->submit(&mars::BiDirectionalIndex::create, &index);
+    std::future<void> future_index{};
+    if (mars::settings.workers == 0 && !mars::settings.genome_file.empty())
+    {
+        auto threads = std::make_shared<mars::ThreadBudget::Reservation>(mars::thread_budget.reserve(1));
+        future_index = mars::pool->submit([&index, threads] { index.create(); });
+    }
 
     // Generate motifs from the MSA
-    mars::Motif motif = mars::create_motif();
+    mars::Motif motif{};
+    {
+        mars::ThreadBudget::Reservation const threads = mars::thread_budget.reserve(mars::settings.nthreads);
+        motif = mars::create_motif(threads.size());
+    }
+    mars::calibrate_motif(motif);
     auto future_mmo = mars::pool->submit(mars::store_motif, motif);
     auto future_rssp = mars::pool->submit(mars::store_rssp, motif);
 
     // Wait for index creation process
-    future_index.wait();
+    if (future_index.valid())
+        future_index.wait();
 
-    if (!motif.empty() && !index.raw().empty())
+    if (!motif.empty() && mars::settings.workers > 0 && !mars::settings.genome_file.empty())
+    {
+        // Scatter the search to worker processes and gather their hits
+        mars::coordinate_search(motif, argc, argv);
+    }
+    else if (!motif.empty() && !index.empty())
     {
         // Search the genome for motif
         mars::find_motif(index, motif);
@@ -46,10 +79,19 @@ int main(int argc, char ** argv)
     }
     future_mmo.wait();
     future_rssp.wait();
+    // The compaction records trace events, thus it must finish before the trace is written.
+    index.wait_for_compaction();
 
     // print run time
     auto const sec = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - tm0).count();
     logger(1, argv[0] << " has finished after " << sec << " seconds." << std::endl);
+    total_timer.stop();
+    mars::phase_report.print();
+    if (mars::tracer.enabled())
+    {
+        mars::tracer.write(mars::settings.trace_file);
+        logger(1, "Stored the trace ==> " << mars::settings.trace_file << std::endl);
+    }
 
     return 0;
 }
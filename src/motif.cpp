@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <seqan3/std/ranges>
@@ -24,7 +25,9 @@
 #endif
 
 #include "motif.hpp"
+#include "phase_report.hpp"
 #include "settings.hpp"
+#include "trace.hpp"
 
 namespace mars
 {
@@ -74,11 +77,21 @@ void filter_profile(auto & queue)
 
 void Stemloop::analyze(Msa const & msa)
 {
-    size_t const depth = msa.sequences.size();
+    analyze(msa, MsaColumns{msa});
+}
+
+void Stemloop::analyze(Msa const & msa, MsaColumns const & columns)
+{
+    TraceScope const trace{"analyze stemloop"};
+    using GappedRna = seqan3::gapped<Msa::Alphabet>;
+    size_t constexpr sigma = seqan3::alphabet_size<GappedRna>;
+    size_t constexpr gap_rank = seqan3::to_rank(GappedRna{seqan3::gap()});
+
+    size_t const depth = columns.rows();
     std::valarray<Position> sl_len_stat(static_cast<Position>(0), depth);
     std::vector<int> const & bpseq = msa.structure.first;
 
-    auto make_stem = [this, &msa, &bpseq, &sl_len_stat, depth] (int & left, int & right)
+    auto make_stem = [this, &columns, &bpseq, &sl_len_stat, depth] (int & left, int & right)
     {
         StemElement & elem = std::get<StemElement>(elements.emplace_back<StemElement>({}));
         std::vector<int> gap_stat(depth, -1);
@@ -87,17 +100,30 @@ void Stemloop::analyze(Msa const & msa)
         {
             assert(bpseq[right] == left);
             elem.gaps.emplace_back();
+
+            // Count the character pairs of the two columns in a histogram.
+            GappedRna const * column_left = columns.column(left);
+            GappedRna const * column_right = columns.column(right);
+            std::array<uint32_t, sigma * sigma> histogram{};
+            for (size_t row = 0; row < depth; ++row)
+            {
+                size_t const rank_left = seqan3::to_rank(column_left[row]);
+                size_t const rank_right = seqan3::to_rank(column_right[row]);
+                ++histogram[rank_left * sigma + rank_right];
+                bool const is_gap = rank_left == gap_rank && rank_right == gap_rank;
+                len_stat[row] += static_cast<Position>((rank_left != gap_rank) + (rank_right != gap_rank));
+                check_gaps(gap_stat[row], elem.gaps, elem.prio.size(), is_gap);
+            }
+
+            // Build the profile from the histogram, omitting double gaps.
             profile_char<bi_alphabet<seqan3::gapped<seqan3::rna4>>> prof{};
-            for (auto &&[current_gap, len, seq] : seqan3::views::zip(gap_stat, len_stat, msa.sequences))
+            for (size_t idx = 0; idx < histogram.size(); ++idx)
             {
-                bool is_gap = seq[left] == seqan3::gap() && seq[right] == seqan3::gap();
-                if (!is_gap)
-                {
-                    prof.increment(seq[left], seq[right]);
-                    len += (seq[left] != seqan3::gap() && seq[right] != seqan3::gap()) ? 2 : 1;
-                }
-                check_gaps(current_gap, elem.gaps, elem.prio.size(), is_gap);
+                if (histogram[idx] > 0 && idx != gap_rank * sigma + gap_rank)
+                    prof.increment(GappedRna{}.assign_rank(idx / sigma), GappedRna{}.assign_rank(idx % sigma),
+                                   histogram[idx]);
             }
+
             elem.prio.push_back(priority(prof, depth));
             filter_profile(elem.prio.back());
             ++left;
@@ -114,7 +140,7 @@ void Stemloop::analyze(Msa const & msa)
         std::reverse(elem.prio.begin(), elem.prio.end());
     };
 
-    auto make_loop = [this, &msa, &bpseq, &sl_len_stat, depth] (int & bpidx, bool leftsided)
+    auto make_loop = [this, &columns, &bpseq, &sl_len_stat, depth] (int & bpidx, bool leftsided)
     {
         LoopElement & elem = std::get<LoopElement>(elements.emplace_back<LoopElement>({}));
         elem.leftsided = leftsided;
@@ -123,14 +149,27 @@ void Stemloop::analyze(Msa const & msa)
         do
         {
             elem.gaps.emplace_back();
+
+            // Count the characters of the column in a histogram.
+            GappedRna const * column = columns.column(bpidx);
+            std::array<uint32_t, sigma> histogram{};
+            for (size_t row = 0; row < depth; ++row)
+            {
+                size_t const rank = seqan3::to_rank(column[row]);
+                ++histogram[rank];
+                bool const is_gap = rank == gap_rank;
+                len_stat[row] += static_cast<Position>(!is_gap);
+                check_gaps(gap_stat[row], elem.gaps, elem.prio.size(), is_gap);
+            }
+
+            // Build the profile from the histogram, omitting gaps.
             profile_char<seqan3::rna4> prof{};
-            for (auto &&[current_gap, len, seq] : seqan3::views::zip(gap_stat, len_stat, msa.sequences))
+            for (size_t rank = 0; rank < histogram.size(); ++rank)
             {
-                bool is_gap = prof.increment(seq[bpidx]);
-                if (!is_gap)
-                    ++len;
-                check_gaps(current_gap, elem.gaps, elem.prio.size(), is_gap);
+                if (histogram[rank] > 0 && rank != gap_rank)
+                    prof.increment(Msa::Alphabet{}.assign_rank(rank), histogram[rank]);
             }
+
             elem.prio.push_back(priority(prof, depth));
             filter_profile(elem.prio.back());
             bpidx += (elem.leftsided ? 1 : -1);
@@ -232,6 +271,17 @@ void Stemloop::print_rssp(std::ofstream & os) const
     os << '\n';
 }
 
+float ScoreCalibration::min_score(size_t db_len, double evalue) const
+{
+    // the probability that the maximum of a window reaches the score, such that evalue chance hits are expected
+    double const prob = evalue * window / static_cast<double>(db_len);
+    if (!valid() || !(prob > 0) || prob >= 1)
+        return 0.f;
+    // invert the Gumbel distribution: P(max >= s) = 1 - exp(-exp(-lambda * (s - mu)))
+    double const score = mu - std::log(-std::log1p(-prob)) / lambda;
+    return static_cast<float>(std::max(0., score));
+}
+
 std::ostream & operator<<(std::ostream & os, Stemloop const & stemloop)
 {
     os << "[" << (+stemloop.uid + 1) << "] STEMLOOP pos = (" << stemloop.bounds.first << ".."
@@ -283,6 +333,7 @@ std::ostream & operator<<(std::ostream & os, Stemloop const & stemloop)
 
 void store_rssp(Motif const & motif)
 {
+    TraceScope const trace{"store rssp"};
     if (settings.structator_file.empty() || motif.empty())
         return;
 
@@ -296,7 +347,7 @@ void store_rssp(Motif const & motif)
     ofs.close();
 }
 
-Motif create_motif()
+Motif create_motif(unsigned int threads)
 {
     if (settings.alignment_file.empty())
         return {};
@@ -306,24 +357,32 @@ Motif create_motif()
 #endif
 
     // Read the alignment
-    Msa msa = read_msa(settings.alignment_file);
+    Msa const msa = read_msa(settings.alignment_file, threads);
+    Motif motif = create_motif(msa);
+    logger(1, "Found " << motif.size() << " stemloops <== " << settings.alignment_file << std::endl);
+    for (auto const & stemloop : motif)
+    {
+        logger(2, stemloop << std::endl);
+    }
+    return motif;
+}
+
+Motif create_motif(Msa const & msa)
+{
+    PhaseReport::Timer const timer = phase_report.measure("motif analysis");
 
     // Find the stem loops
     Motif motif = detect_stemloops(msa.structure.first, msa.structure.second);
 
-    // Analyze each stemloop
+    // Analyze each stemloop, sharing the alignment and its column-major copy
+    MsaColumns const columns{msa};
     std::vector<std::future<void>> futures;
+    void (Stemloop::*analyze_fn)(Msa const &, MsaColumns const &) = &Stemloop::analyze;
     for (Stemloop & stemloop : motif)
-        futures.push_back(pool->submit(&Stemloop::analyze, &stemloop, msa));
+        futures.push_back(pool->submit(analyze_fn, &stemloop, std::cref(msa), std::cref(columns)));
 
     for (auto & future : futures)
         future.wait();
-
-    logger(1, "Found " << motif.size() << " stemloops <== " << settings.alignment_file << std::endl);
-    for (auto const & stemloop : motif)
-    {
-        logger(2, stemloop << std::endl);
-    }
     return motif;
 }
 
@@ -402,9 +461,16 @@ Motif restore_motif(std::filesystem::path const & motif_file)
         cereal::BinaryInputArchive iarchive{ifs};
         std::string version;
         iarchive(version);
-        if (version[0] == '1')
+        if (version[0] == '1' || version[0] == '2')
         {
             iarchive(motif);
+            if (version[0] == '2') // the score calibration follows the stemloops
+            {
+                std::vector<ScoreCalibration> calibrations{};
+                iarchive(calibrations);
+                for (size_t idx = 0; idx < std::min(motif.size(), calibrations.size()); ++idx)
+                    motif[idx].calibration = calibrations[idx];
+            }
             logger(1, "Restored " << motif.size() << " stemloops <== " << motif_file << std::endl);
         }
     }
@@ -412,21 +478,32 @@ Motif restore_motif(std::filesystem::path const & motif_file)
     return motif;
 }
 
-void store_motif(Motif const & motif)
+bool write_motif(Motif const & motif, std::filesystem::path const & motif_file)
 {
-    if (settings.motif_file.empty() || motif.empty())
-        return;
-    std::ofstream ofs{settings.motif_file, std::ios::binary};
+    std::ofstream ofs{motif_file, std::ios::binary};
     if (ofs)
     {
         // Write the index to disk, including a version string.
         cereal::BinaryOutputArchive oarchive{ofs};
-        std::string const version{"1 mars vector<Stemloop>\n"};
+        std::string const version{"2 mars vector<Stemloop> vector<ScoreCalibration>\n"};
         oarchive(version);
         oarchive(motif);
-        logger(1, "Stored " << motif.size() << " stemloops ==> " << settings.motif_file << std::endl);
+        std::vector<ScoreCalibration> calibrations{};
+        for (Stemloop const & stemloop : motif)
+            calibrations.push_back(stemloop.calibration);
+        oarchive(calibrations);
     }
     ofs.close();
+    return static_cast<bool>(ofs);
+}
+
+void store_motif(Motif const & motif)
+{
+    TraceScope const trace{"store motif"};
+    if (settings.motif_file.empty() || motif.empty())
+        return;
+    if (write_motif(motif, settings.motif_file))
+        logger(1, "Stored " << motif.size() << " stemloops ==> " << settings.motif_file << std::endl);
 }
 #endif
 
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cmath>
 #include <ostream>
 #include <tuple>
 #include <unordered_map>
@@ -98,6 +99,49 @@ struct StemElement
 #endif
 };
 
+/*!
+ * \brief The score distribution of a stemloop on background sequence, modelled as an extreme value distribution.
+ *
+ * \details
+ * The maximum score of the stemloop within a background window of fixed length is Gumbel distributed with
+ * location `mu` and scale `1/lambda`, which predicts how often a score is reached by chance in a larger database.
+ */
+struct ScoreCalibration
+{
+    float lambda{NAN}; //!< The inverse scale of the Gumbel distribution, NAN if the stemloop is not calibrated.
+    float mu{NAN}; //!< The location of the Gumbel distribution.
+    uint32_t window{0}; //!< The length of the background windows whose maximum scores were fitted.
+
+    //! \brief Whether the distribution has been fitted.
+    bool valid() const
+    {
+        return std::isfinite(lambda) && lambda > 0 && std::isfinite(mu) && window > 0;
+    }
+
+    /*!
+     * \brief The minimum score of a hit that is expected to occur at most `evalue` times by chance in a database.
+     * \param db_len The total length of the database.
+     * \param evalue The tolerated number of chance hits.
+     * \return the minimum score, or zero if the stemloop is not calibrated.
+     */
+    float min_score(size_t db_len, double evalue) const;
+
+#if SEQAN3_WITH_CEREAL
+    /*!
+     * \brief Function that guides Cereal serialization.
+     * \tparam Archive Type of the Cereal archive.
+     * \param archive The archive.
+     */
+    template <seqan3::cereal_archive Archive>
+    void serialize(Archive & archive)
+    {
+        archive(lambda);
+        archive(mu);
+        archive(window);
+    }
+#endif
+};
+
 //! \brief A stemloop consists of a series of loop and stem elements.
 struct Stemloop
 {
@@ -113,6 +157,9 @@ struct Stemloop
     //! \brief A vector of loop and stem elements that the stemloop consists of.
     std::vector<std::variant<LoopElement, StemElement>> elements;
 
+    //! \brief The score distribution on background sequence, which is stored separately in the motif file.
+    ScoreCalibration calibration;
+
     /*!
      * \brief Constructor for a stemloop.
      * \param id A unique ID for the stemloop.
@@ -122,12 +169,13 @@ struct Stemloop
         uid{id},
         bounds{std::move(pos)},
         length{},
-        elements{}
+        elements{},
+        calibration{}
     {}
 
 #if SEQAN3_WITH_CEREAL
     //! \brief Default constructor for serialization.
-    Stemloop() : uid{}, bounds{}, length{}, elements{}
+    Stemloop() : uid{}, bounds{}, length{}, elements{}, calibration{}
     {}
 
     /*!
@@ -151,6 +199,13 @@ struct Stemloop
      */
     void analyze(Msa const & msa);
 
+    /*!
+     * \brief Analyze the stemloop's properties based on the MSA and interactions.
+     * \param msa The multiple structural alignment.
+     * \param columns The column-major copy of the alignment.
+     */
+    void analyze(Msa const & msa, MsaColumns const & columns);
+
     /*!
      * \brief Print the stemloop as RSSP for the Structator program.
      * \param[in,out] os The output stream.
@@ -177,10 +232,17 @@ void store_rssp(Motif const & motif);
 
 /*!
  * \brief Create the motif descriptors by analysing a multiple sequence-structure alignment.
- * \param threads The maximum number of threads allowed for execution.
+ * \param threads The number of threads for predicting the structure, which the caller has reserved.
+ * \return A motif (vector of stemloops).
+ */
+Motif create_motif(unsigned int threads = 1);
+
+/*!
+ * \brief Create the motif descriptors from an alignment whose consensus structure is known.
+ * \param msa The multiple structural alignment.
  * \return A motif (vector of stemloops).
  */
-Motif create_motif();
+Motif create_motif(Msa const & msa);
 
 /*!
  * \brief Extract the positions of the stem loops.
@@ -215,6 +277,14 @@ std::vector<std::pair<float, alph_type>> priority(profile_char<alph_type> pch, s
  */
 Motif restore_motif(std::filesystem::path const & motif_file);
 
+/*!
+ * \brief Write the motif to a file, such that it can be restored.
+ * \param motif The motif.
+ * \param motif_file The filename.
+ * \return whether the file could be written.
+ */
+bool write_motif(Motif const & motif, std::filesystem::path const & motif_file);
+
 /*!
  * \brief Write the motif to a file.
  * \param motifs The motif.
@@ -7,31 +7,41 @@
 
 #include <seqan3/std/algorithm>
 #include <seqan3/std/iterator>
+#include <limits>
+#include <numeric>
 
+#include <seqan3/alphabet/gap/gap.hpp>
 #include <seqan3/alphabet/views/to_char.hpp>
 #include <seqan3/utility/views/zip.hpp>
 
 #include "format_clustal.hpp"
 #include "format_stockholm.hpp"
 #include "multiple_alignment.hpp"
+#include "phase_report.hpp"
+#include "settings.hpp"
 #include "structure.hpp"
 
 namespace mars
 {
 
-Msa read_msa(std::filesystem::path const & filepath)
+Msa read_msa(std::filesystem::path const & filepath, unsigned int threads)
 {
     if (filepath.extension() == std::filesystem::path{".aln"} ||
         filepath.extension() == std::filesystem::path{".msa"})
     {
-        Msa msa = read_clustal_file<typename Msa::Alphabet>(filepath);
-        compute_structure(msa);
+        Msa msa{};
+        {
+            PhaseReport::Timer const timer = phase_report.measure("alignment parse");
+            msa = read_clustal_file<typename Msa::Alphabet>(filepath);
+        }
+        compute_structure(msa, threads);
         return msa;
     }
     else if (filepath.extension() == std::filesystem::path{".sth"} ||
              filepath.extension() == std::filesystem::path{".stk"} ||
              filepath.extension() == std::filesystem::path{".sto"})
     {
+        PhaseReport::Timer const timer = phase_report.measure("alignment parse");
         return read_stockholm_file<typename Msa::Alphabet>(filepath);
     }
     else
@@ -40,19 +50,98 @@ Msa read_msa(std::filesystem::path const & filepath)
     }
 }
 
-void compute_structure(Msa & msa)
+MsaColumns::MsaColumns(Msa const & msa) : depth{msa.sequences.size()}
 {
-    // Convert names
-    std::list<std::string> names{msa.names.size()};
-    std::ranges::copy(msa.names, names.begin());
+    size_t const width = msa.sequences.empty() ? size_t{0} : msa.sequences.front().size();
+    characters.resize(width * depth);
 
-    // Convert sequences
-    std::list<std::string> seqs{msa.sequences.size()};
-    auto && char_seq = msa.sequences | seqan3::views::to_char;
-    for (auto && [src, trg] : seqan3::views::zip(char_seq, seqs))
-        std::ranges::copy(src, std::cpp20::back_inserter(trg));
+    // Transpose in tiles of rows, so that the written columns stay in the cache.
+    size_t constexpr tile = 64;
+    for (size_t row_begin = 0; row_begin < depth; row_begin += tile)
+    {
+        size_t const row_end = std::min(row_begin + tile, depth);
+        for (size_t col = 0; col < width; ++col)
+            for (size_t row = row_begin; row < row_end; ++row)
+                characters[col * depth + row] = msa.sequences[row][col];
+    }
+}
+
+std::vector<size_t> select_diverse_rows(Msa const & msa, size_t count)
+{
+    size_t const num_rows = msa.sequences.size();
+    std::vector<size_t> selection{};
+    if (count >= num_rows)
+    {
+        selection.resize(num_rows);
+        std::iota(selection.begin(), selection.end(), size_t{0});
+        return selection;
+    }
 
-    msa.structure = run_ipknot(names, seqs);
+    // The fraction of mismatches in the columns where at least one of the rows has a nucleotide.
+    auto distance = [&msa] (size_t row_a, size_t row_b)
+    {
+        size_t columns{0};
+        size_t mismatches{0};
+        for (auto && [chr_a, chr_b] : seqan3::views::zip(msa.sequences[row_a], msa.sequences[row_b]))
+        {
+            if (chr_a == seqan3::gap{} && chr_b == seqan3::gap{})
+                continue;
+            ++columns;
+            if (chr_a != chr_b)
+                ++mismatches;
+        }
+        return columns == 0 ? 0.f : static_cast<float>(mismatches) / columns;
+    };
+
+    // The distance of each row to its closest selected row, negative for selected rows.
+    std::vector<float> min_distance(num_rows, std::numeric_limits<float>::max());
+    selection.reserve(count);
+    size_t next{0};
+    while (selection.size() < count)
+    {
+        selection.push_back(next);
+        min_distance[next] = -1.f;
+        float max_distance{-1.f};
+        for (size_t row = 0; row < num_rows; ++row)
+        {
+            if (min_distance[row] < 0.f)
+                continue;
+            min_distance[row] = std::min(min_distance[row], distance(selection.back(), row));
+            if (min_distance[row] > max_distance)
+            {
+                max_distance = min_distance[row];
+                next = row;
+            }
+        }
+    }
+    std::sort(selection.begin(), selection.end());
+    return selection;
+}
+
+void compute_structure(Msa & msa, unsigned int threads)
+{
+    PhaseReport::Timer const timer = phase_report.measure("structure prediction");
+    std::vector<size_t> const rows = select_diverse_rows(msa, settings.fold_depth == 0 ? msa.sequences.size()
+                                                                                      : settings.fold_depth);
+    if (rows.size() < msa.sequences.size())
+        logger(1, "Predict the structure from " << rows.size() << " of " << msa.sequences.size() << " sequences."
+                  << std::endl);
+
+    // Convert names and sequences
+    std::list<std::string> names{};
+    std::list<std::string> seqs{};
+    for (size_t row : rows)
+    {
+        names.push_back(msa.names[row]);
+        seqs.emplace_back();
+        std::ranges::copy(msa.sequences[row] | seqan3::views::to_char, std::cpp20::back_inserter(seqs.back()));
+    }
+
+    bool const alifold = settings.fold_engine == "alifold";
+    if (settings.fold_method == "ipknot")
+        msa.structure = run_ipknot(names, seqs, static_cast<int>(std::max(1u, threads)), alifold);
+    else
+        msa.structure = run_mea(names, seqs, settings.fold_method == "mea-pk", alifold);
 }
 
 } // namespace mars
@@ -42,17 +42,69 @@ struct MultipleAlignment
  */
 typedef MultipleAlignment<seqan3::rna15> Msa;
 
+/*!
+ * \brief An immutable column-major copy of the alignment characters.
+ *
+ * The motif analysis accumulates profiles column by column over all rows. In this layout each column is a
+ * contiguous array, which avoids a strided access into every row for each character.
+ */
+class MsaColumns
+{
+private:
+    //! \brief The number of alignment rows.
+    size_t depth;
+    //! \brief The characters of all columns, concatenated.
+    std::vector<seqan3::gapped<Msa::Alphabet>> characters;
+
+public:
+    /*!
+     * \brief Constructor that transposes the alignment.
+     * \param msa The multiple alignment, whose rows must have equal length.
+     */
+    explicit MsaColumns(Msa const & msa);
+
+    //! \brief The number of rows, i.e. the length of each column.
+    size_t rows() const
+    {
+        return depth;
+    }
+
+    /*!
+     * \brief Access a column of the alignment.
+     * \param col The column index.
+     * \return A pointer to the first of `rows()` consecutive characters.
+     */
+    seqan3::gapped<Msa::Alphabet> const * column(size_t col) const
+    {
+        return characters.data() + col * depth;
+    }
+};
+
 /*!
  * \brief Read a CLUSTAL file (*.aln) into a multiple alignment representation.
  * \param filepath The file where the alignment is stored.
+ * \param threads The number of threads for predicting the consensus structure.
  * \return The alignment.
  */
-Msa read_msa(std::filesystem::path const & filepath);
+Msa read_msa(std::filesystem::path const & filepath, unsigned int threads = 1);
+
+/*!
+ * \brief Select a diverse subset of the alignment rows.
+ * \param msa The multiple structural alignment.
+ * \param count The maximum number of rows to select.
+ * \return The indices of the selected rows in ascending order.
+ *
+ * The selection is a greedy farthest-first traversal: starting with the first row, we repeatedly add the row
+ * with the lowest sequence identity to its closest already selected row. Thus the subset covers the clusters of
+ * the alignment instead of picking near-identical members.
+ */
+std::vector<size_t> select_diverse_rows(Msa const & msa, size_t count);
 
 /*!
  * \brief Compute the secondary structure of a given multiple structural alignment.
  * \param msa The multiple structural alignment.
+ * \param threads The number of threads, which the caller has reserved from the thread budget.
  */
-void compute_structure(Msa & msa);
+void compute_structure(Msa & msa, unsigned int threads = 1);
 
 } // namespace mars
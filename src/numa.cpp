@@ -0,0 +1,207 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#if defined(__linux__) && __has_include(<linux/mempolicy.h>)
+#define MARS_HAS_NUMA 1
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define MARS_HAS_NUMA 0
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <seqan3/std/filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "numa.hpp"
+#include "settings.hpp"
+
+namespace mars
+{
+
+//! \brief A NUMA node with its CPUs.
+struct NumaNode
+{
+    unsigned int id; //!< The node number of the kernel.
+    std::vector<unsigned int> cpus; //!< The CPUs of the node.
+};
+
+/*!
+ * \brief Parse a CPU list of sysfs.
+ * \param list A list of CPU numbers and ranges, e.g. "0-3,8-11".
+ * \return the CPU numbers.
+ */
+static std::vector<unsigned int> parse_cpu_list(std::string const & list)
+{
+    std::vector<unsigned int> cpus{};
+    std::istringstream stream{list};
+    std::string range{};
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        size_t const dash = range.find('-');
+        unsigned int const first = std::stoul(range.substr(0, dash));
+        unsigned int const last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+        for (unsigned int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+//! \brief The NUMA nodes with CPUs, which are read once from sysfs.
+static std::vector<NumaNode> const & numa_nodes()
+{
+    static std::vector<NumaNode> const nodes = [] ()
+    {
+        std::vector<NumaNode> result{};
+#if MARS_HAS_NUMA
+        std::filesystem::path const sysfs{"/sys/devices/system/node"};
+        std::error_code error{};
+        for (auto const & entry : std::filesystem::directory_iterator{sysfs, error})
+        {
+            std::string const name = entry.path().filename().string();
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != name.npos)
+                continue;
+            std::ifstream ifs{entry.path() / "cpulist"};
+            std::string list{};
+            std::getline(ifs, list);
+            NumaNode node{static_cast<unsigned int>(std::stoul(name.substr(4))), parse_cpu_list(list)};
+            if (!node.cpus.empty())
+                result.push_back(std::move(node));
+        }
+        std::sort(result.begin(), result.end(), [] (NumaNode const & left, NumaNode const & right)
+        {
+            return left.id < right.id;
+        });
+#endif
+        return result;
+    }();
+    return nodes;
+}
+
+//! \brief The node of the calling thread, which is set when the thread is pinned.
+static thread_local size_t thread_node{0};
+
+//! \brief Whether the calling thread has been pinned.
+static thread_local bool thread_pinned{false};
+
+size_t Numa::node_count()
+{
+    return std::max<size_t>(1ul, numa_nodes().size());
+}
+
+size_t Numa::current_node()
+{
+    return thread_node;
+}
+
+bool Numa::is_pinned()
+{
+    return thread_pinned;
+}
+
+void Numa::pin_current_thread([[maybe_unused]] size_t node)
+{
+#if MARS_HAS_NUMA
+    if (node_count() < 2 || node >= node_count())
+        return;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (unsigned int cpu : numa_nodes()[node].cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpu_set);
+    // The thread id 0 selects the calling thread.
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+    {
+        thread_node = node;
+        thread_pinned = true;
+    }
+#endif
+}
+
+void Numa::pin_pool_workers()
+{
+    if (!pool || node_count() < 2)
+        return;
+
+    // The tasks wait for each other, such that each worker executes exactly one of them.
+    size_t const workers = pool->capacity();
+    size_t started{0};
+    std::mutex mutex_started{};
+    std::condition_variable cv_started{};
+    std::vector<std::future<void>> futures{};
+    for (size_t idx = 0; idx < workers; ++idx)
+    {
+        futures.push_back(pool->submit([&started, &mutex_started, &cv_started, workers] ()
+        {
+            size_t worker{};
+            {
+                std::unique_lock<std::mutex> lock(mutex_started);
+                worker = started++;
+                if (started == workers)
+                    cv_started.notify_all();
+                else
+                    cv_started.wait(lock, [&started, workers] { return started == workers; });
+            }
+            pin_current_thread(worker * node_count() / workers);
+        }));
+    }
+    for (auto & future : futures)
+        future.get();
+    logger(2, "Pinned " << workers << " threads to " << node_count() << " NUMA nodes." << std::endl);
+}
+
+void Numa::run_on_node(size_t node, std::function<void()> const & task)
+{
+    std::exception_ptr error{};
+    std::thread thread{[node, &task, &error] ()
+    {
+        pin_current_thread(node);
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    }};
+    thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void Numa::interleave_allocations([[maybe_unused]] bool enable)
+{
+#if MARS_HAS_NUMA
+    if (node_count() < 2)
+        return;
+    if (!enable)
+    {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0ul);
+        return;
+    }
+    std::vector<unsigned long> mask(numa_nodes().back().id / 64 + 1, 0ul);
+    for (NumaNode const & node : numa_nodes())
+        mask[node.id / 64] |= 1ul << (node.id % 64);
+    // The kernel expects the number of mask bits plus one.
+    if (syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * 64 + 1) != 0)
+        logger(1, "Could not interleave the index memory across the NUMA nodes." << std::endl);
+#endif
+}
+
+} // namespace mars
@@ -0,0 +1,64 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace mars
+{
+
+/*!
+ * \brief The NUMA nodes of the machine and the placement of threads and memory on them.
+ *
+ * \details
+ * The topology is read from sysfs and threads are placed with the scheduler affinity and the memory policy system
+ * calls of Linux, such that no NUMA library is needed. On other systems and on single-node machines there is
+ * exactly one node and all functions leave the threads and the memory placement unchanged.
+ * Memory is allocated on the node of the thread that first writes to it, which is how replicas become local.
+ */
+class Numa
+{
+public:
+    //! \brief The number of NUMA nodes that have CPUs.
+    static size_t node_count();
+
+    //! \brief The node of the calling thread, if it has been pinned, and 0 otherwise.
+    static size_t current_node();
+
+    //! \brief Whether the calling thread has been pinned to a node, such that its allocations are placed there.
+    static bool is_pinned();
+
+    /*!
+     * \brief Pin the calling thread to the CPUs of a node.
+     * \param node The node number.
+     */
+    static void pin_current_thread(size_t node);
+
+    /*!
+     * \brief Pin each worker of the thread pool to a node, distributing the workers evenly among the nodes.
+     * \details The pool must be idle, because each worker has to pick up exactly one pinning task.
+     */
+    static void pin_pool_workers();
+
+    /*!
+     * \brief Run a function on a temporary thread that is pinned to a node, and wait for it.
+     * \param node The node number.
+     * \param task The function, whose allocations are placed on the node.
+     */
+    static void run_on_node(size_t node, std::function<void()> const & task);
+
+    /*!
+     * \brief Interleave the pages that the calling thread allocates across all nodes, or stop doing so.
+     * \param enable Whether to interleave; false restores the default policy of local allocation.
+     */
+    static void interleave_allocations(bool enable);
+};
+
+} // namespace mars
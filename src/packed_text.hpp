@@ -0,0 +1,136 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <seqan3/std/ranges>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+
+namespace mars
+{
+
+/*!
+ * \brief A collection of nucleotide sequences that are stored contiguously with 2 bits per character.
+ *
+ * \details
+ * The text needs a quarter of the memory of `std::vector<seqan3::dna4_vector>`. It is filled by appending
+ * zero-initialized sequences and setting each character once, which allows for converting parts of the text
+ * concurrently. The sequences are accessible as random access views, which the index is constructed from.
+ */
+class PackedText
+{
+private:
+    std::vector<uint64_t> words{}; //!< The characters, 32 per word starting with the lowest bits.
+    std::vector<size_t> bounds{0ul}; //!< The start positions of the sequences, followed by the total length.
+
+public:
+    //! \brief Converts a text position into a nucleotide.
+    struct Decoder
+    {
+        uint64_t const * words; //!< The packed characters.
+
+        //! \brief The character at a position of the text.
+        seqan3::dna4 operator()(size_t pos) const
+        {
+            return seqan3::dna4{}.assign_rank((words[pos / 32] >> (2 * (pos % 32))) & 3u);
+        }
+    };
+
+    //! \brief A random access view of a sequence, which is invalidated when sequences are added.
+    using Sequence = decltype(std::views::iota(size_t{}, size_t{}) | std::views::transform(Decoder{}));
+
+    //! \brief The number of sequences.
+    size_t sequence_count() const
+    {
+        return bounds.size() - 1;
+    }
+
+    //! \brief The total number of characters.
+    size_t size() const
+    {
+        return bounds.back();
+    }
+
+    //! \brief The allocated memory in bytes.
+    size_t memory_size() const
+    {
+        return words.capacity() * sizeof(uint64_t) + bounds.capacity() * sizeof(size_t);
+    }
+
+    //! \brief The global position of the first character of a sequence.
+    size_t sequence_begin(size_t idx) const
+    {
+        return bounds[idx];
+    }
+
+    /*!
+     * \brief Append a sequence whose characters are set afterwards.
+     * \param length The number of characters, which are initialized with A.
+     */
+    void add_sequence(size_t length)
+    {
+        bounds.push_back(bounds.back() + length);
+        words.resize((bounds.back() + 31) / 32, 0ull);
+    }
+
+    /*!
+     * \brief Set a character that has not been set before.
+     * \param pos The global position in the text.
+     * \param chr The character.
+     * \param shared Whether other threads may set characters of the same word concurrently.
+     */
+    void set(size_t pos, seqan3::dna4 chr, bool shared = false)
+    {
+        uint64_t const bits = static_cast<uint64_t>(chr.to_rank()) << (2 * (pos % 32));
+        if (shared)
+            __atomic_fetch_or(&words[pos / 32], bits, __ATOMIC_RELAXED);
+        else
+            words[pos / 32] |= bits;
+    }
+
+    //! \brief Append a sequence of nucleotides.
+    template <typename sequence_t>
+    void push_back(sequence_t const & seq)
+    {
+        size_t pos = size();
+        add_sequence(std::ranges::size(seq));
+        for (seqan3::dna4 chr : seq)
+            set(pos++, chr);
+    }
+
+    /*!
+     * \brief Access a sequence.
+     * \param idx The sequence number.
+     * \return a view of the characters.
+     */
+    Sequence sequence(size_t idx) const
+    {
+        return std::views::iota(bounds[idx], bounds[idx + 1]) | std::views::transform(Decoder{words.data()});
+    }
+
+    //! \brief The views of all sequences, which are the input for the index construction.
+    std::vector<Sequence> sequences() const
+    {
+        std::vector<Sequence> result{};
+        result.reserve(sequence_count());
+        for (size_t idx = 0; idx < sequence_count(); ++idx)
+            result.push_back(sequence(idx));
+        return result;
+    }
+
+    //! \brief Serialize the text with cereal.
+    template <typename archive_t>
+    void serialize(archive_t & archive)
+    {
+        archive(words, bounds);
+    }
+};
+
+} // namespace mars
@@ -0,0 +1,83 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "parallel_for.hpp"
+#include "settings.hpp"
+#include "thread_budget.hpp"
+
+namespace mars
+{
+
+void parallel_for(size_t count, std::function<void(size_t)> const & task)
+{
+    if (count == 0)
+        return;
+
+    // The state is shared with the helper tasks, which may start after this function has returned.
+    struct State
+    {
+        std::atomic<size_t> next{0};
+        size_t done{0};
+        size_t count;
+        std::function<void(size_t)> const * task;
+        std::exception_ptr error{};
+        std::mutex mutex_state{};
+        std::condition_variable cv_done{};
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->task = &task;
+
+    auto work = [state] ()
+    {
+        for (size_t idx = state->next++; idx < state->count; idx = state->next++)
+        {
+            std::exception_ptr error{};
+            try
+            {
+                (*state->task)(idx);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> guard(state->mutex_state);
+            if (error && !state->error)
+                state->error = error;
+            if (++state->done == state->count)
+                state->cv_done.notify_all();
+        }
+    };
+
+    unsigned int const wanted = std::min<size_t>(count, settings.nthreads) - 1;
+    if (wanted > 0 && pool)
+    {
+        // the caller is already accounted for, so the helpers only use threads that are left in the budget
+        ThreadBudget::Reservation const helpers = thread_budget.reserve(wanted, 0);
+        for (int idx = 0; idx < helpers.size(); ++idx)
+            pool->submit(work);
+        work();
+    }
+    else
+    {
+        work();
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex_state);
+    state->cv_done.wait(lock, [&state] { return state->done == state->count; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+} // namespace mars
@@ -0,0 +1,28 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace mars
+{
+
+/*!
+ * \brief Run a task for each number in [0, count) on the calling thread and on idle threads of the pool.
+ * \param count The number of tasks.
+ * \param task The task, which receives the task number.
+ * \throws Any exception that a task has thrown, after all tasks are finished.
+ *
+ * \details
+ * The calling thread takes part in the work, thus the function does not deadlock if it is called from a task
+ * of the pool while all other threads of the pool are busy.
+ */
+void parallel_for(size_t count, std::function<void(size_t)> const & task);
+
+} // namespace mars
@@ -0,0 +1,90 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#if __has_include(<linux/perf_event.h>)
+#define MARS_HAS_PERF_EVENT 1
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define MARS_HAS_PERF_EVENT 0
+#endif
+
+#include <algorithm>
+
+#include "perf_counters.hpp"
+
+namespace mars
+{
+
+#if MARS_HAS_PERF_EVENT
+//! \brief The perf configuration (type and config) of each event.
+static constexpr std::array<std::pair<uint32_t, uint64_t>, static_cast<size_t>(PerfEvent::size)> perf_configs
+{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+}};
+#endif
+
+PerfCounters::PerfCounters([[maybe_unused]] bool process)
+{
+    fds.fill(-1);
+#if MARS_HAS_PERF_EVENT
+    for (size_t idx = 0; idx < fds.size(); ++idx)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = perf_configs[idx].first;
+        attr.config = perf_configs[idx].second;
+        attr.inherit = process ? 1 : 0;
+        // Counting only user space is permitted with the default perf_event_paranoid level.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // pid = 0 and cpu = -1: count the calling thread (and its future children) on any CPU.
+        fds[idx] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if MARS_HAS_PERF_EVENT
+    for (int fd : fds)
+        if (fd >= 0)
+            close(fd);
+#endif
+}
+
+bool PerfCounters::available() const
+{
+    return std::any_of(fds.cbegin(), fds.cend(), [] (int fd) { return fd >= 0; });
+}
+
+PerfValues PerfCounters::read() const
+{
+    PerfValues values{};
+    values.counts.fill(UINT64_MAX);
+#if MARS_HAS_PERF_EVENT
+    for (size_t idx = 0; idx < fds.size(); ++idx)
+    {
+        uint64_t count{};
+        if (fds[idx] >= 0 && ::read(fds[idx], &count, sizeof(count)) == sizeof(count))
+            values.counts[idx] = count;
+    }
+#endif
+    return values;
+}
+
+PerfCounters const & PerfCounters::thread_local_counters()
+{
+    thread_local PerfCounters const counters{false};
+    return counters;
+}
+
+} // namespace mars
@@ -0,0 +1,106 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mars
+{
+
+//! \brief The hardware events that MaRs counts.
+enum class PerfEvent : uint8_t
+{
+    cycles,
+    instructions,
+    llc_misses,
+    branch_misses,
+    size //!< The number of events.
+};
+
+//! \brief The names of the hardware events, as used in the reports.
+inline constexpr std::array<char const *, static_cast<size_t>(PerfEvent::size)> perf_event_names
+{
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+//! \brief The values of the hardware counters. An event that is not available is counted as UINT64_MAX.
+struct PerfValues
+{
+    //! \brief The counted events, indexed by PerfEvent.
+    std::array<uint64_t, static_cast<size_t>(PerfEvent::size)> counts{};
+
+    //! \brief Whether at least one event has been counted.
+    bool available() const
+    {
+        for (uint64_t count : counts)
+            if (count != UINT64_MAX)
+                return true;
+        return false;
+    }
+
+    //! \brief The difference of two snapshots, where unavailable events stay unavailable.
+    PerfValues operator-(PerfValues const & other) const
+    {
+        PerfValues result{};
+        for (size_t idx = 0; idx < counts.size(); ++idx)
+            result.counts[idx] = (counts[idx] == UINT64_MAX || other.counts[idx] == UINT64_MAX) ?
+                                 UINT64_MAX : counts[idx] - other.counts[idx];
+        return result;
+    }
+
+    //! \brief Accumulate the counts of another measurement.
+    PerfValues & operator+=(PerfValues const & other)
+    {
+        for (size_t idx = 0; idx < counts.size(); ++idx)
+            counts[idx] = (counts[idx] == UINT64_MAX || other.counts[idx] == UINT64_MAX) ?
+                          UINT64_MAX : counts[idx] + other.counts[idx];
+        return *this;
+    }
+};
+
+/*!
+ * \brief A set of hardware performance counters, based on the `perf_event_open` system call of Linux.
+ *
+ * \details
+ * The counters run from construction until destruction, and read() returns a snapshot of the current values.
+ * Events that the kernel does not provide (no PMU in a virtual machine, a restrictive perf_event_paranoid setting,
+ * or a system other than Linux) are silently reported as unavailable.
+ */
+class PerfCounters
+{
+private:
+    //! \brief The file descriptors of the counters, or -1 if the event is not available.
+    std::array<int, static_cast<size_t>(PerfEvent::size)> fds{};
+
+public:
+    /*!
+     * \brief Open the counters.
+     * \param process Whether the counters include the threads that the calling thread creates afterwards.
+     *                Otherwise only the calling thread is counted.
+     */
+    explicit PerfCounters(bool process);
+
+    PerfCounters(PerfCounters const &) = delete;
+    PerfCounters & operator=(PerfCounters const &) = delete;
+
+    //! \brief Close the counters.
+    ~PerfCounters();
+
+    //! \brief Whether at least one event is counted.
+    bool available() const;
+
+    //! \brief A snapshot of the current counter values.
+    PerfValues read() const;
+
+    //! \brief The counters of the calling thread, which are opened on first access.
+    static PerfCounters const & thread_local_counters();
+};
+
+} // namespace mars
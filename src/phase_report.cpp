@@ -0,0 +1,226 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <seqan3/io/exception.hpp>
+
+#include "phase_report.hpp"
+#include "settings.hpp"
+#include "trace.hpp"
+
+namespace mars
+{
+
+PhaseReport phase_report{};
+
+//! \brief The user and system time of the process in seconds.
+static double process_cpu_time()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+//! \brief The peak resident set size of the process in kilobytes.
+static long process_peak_rss()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+PhaseReport::Timer::Timer(PhaseReport * report, char const * name) :
+    report{report},
+    name{name},
+    wall_start{std::chrono::steady_clock::now()},
+    trace_start{tracer.enabled() ? tracer.now() : 0ul},
+    cpu_start{process_cpu_time()},
+    perf_start{report->counters ? report->counters->read() : PerfValues{}}
+{}
+
+PhaseReport::Timer::Timer(Timer && other) noexcept :
+    report{other.report},
+    name{other.name},
+    wall_start{other.wall_start},
+    trace_start{other.trace_start},
+    cpu_start{other.cpu_start},
+    perf_start{other.perf_start}
+{
+    other.report = nullptr;
+}
+
+void PhaseReport::Timer::stop()
+{
+    if (report == nullptr)
+        return;
+
+    double const wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double const cpu = process_cpu_time() - cpu_start;
+    long const peak_rss_kb = process_peak_rss();
+    PerfValues const perf = report->counters ? report->counters->read() - perf_start : PerfValues{};
+    if (tracer.enabled())
+        tracer.record(name, "phase", trace_start, tracer.now());
+    std::lock_guard<std::mutex> guard(report->mutex_report);
+    report->phases.push_back({name, wall, cpu, peak_rss_kb, perf});
+    report = nullptr;
+}
+
+PhaseReport::TaskCounter::TaskCounter(char const * name) :
+    name{phase_report.counters_enabled() ? name : nullptr},
+    perf_start{this->name ? PerfCounters::thread_local_counters().read() : PerfValues{}}
+{}
+
+PhaseReport::TaskCounter::~TaskCounter()
+{
+    if (name == nullptr)
+        return;
+
+    PerfValues const perf = PerfCounters::thread_local_counters().read() - perf_start;
+    std::lock_guard<std::mutex> guard(phase_report.mutex_report);
+    auto iter = std::find_if(phase_report.task_perf.begin(), phase_report.task_perf.end(),
+                             [this] (TaskPerf const & task) { return std::strcmp(task.name, name) == 0; });
+    if (iter == phase_report.task_perf.end())
+        phase_report.task_perf.push_back({name, 1ul, perf});
+    else
+    {
+        ++iter->tasks;
+        iter->perf += perf;
+    }
+}
+
+bool PhaseReport::enable_counters()
+{
+    counters = std::make_unique<PerfCounters>(true);
+    return counters->available();
+}
+
+//! \brief Print the hardware events as table columns, where unavailable events are shown as a dash.
+static void print_perf_columns(std::ostream & stream, PerfValues const & perf)
+{
+    for (uint64_t count : perf.counts)
+    {
+        if (count == UINT64_MAX)
+            stream << std::setw(16) << "-";
+        else
+            stream << std::setw(16) << count;
+    }
+    uint64_t const cycles = perf.counts[static_cast<size_t>(PerfEvent::cycles)];
+    uint64_t const instructions = perf.counts[static_cast<size_t>(PerfEvent::instructions)];
+    if (cycles == UINT64_MAX || instructions == UINT64_MAX || cycles == 0)
+        stream << std::setw(8) << "-";
+    else
+        stream << std::setw(8) << 1.0 * instructions / cycles;
+}
+
+//! \brief Print the hardware events as a JSON object, where unavailable events are null.
+static void print_perf_json(std::ostream & stream, PerfValues const & perf)
+{
+    stream << "{";
+    for (size_t idx = 0; idx < perf.counts.size(); ++idx)
+    {
+        stream << (idx == 0 ? "" : ", ") << "\"" << perf_event_names[idx] << "\": ";
+        if (perf.counts[idx] == UINT64_MAX)
+            stream << "null";
+        else
+            stream << perf.counts[idx];
+    }
+    stream << "}";
+}
+
+bool PhaseReport::enabled() const
+{
+    return settings.verbose >= 2 || !settings.report_file.empty();
+}
+
+void PhaseReport::add_memory(std::string name, size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(mutex_report);
+    memory.emplace_back(std::move(name), bytes);
+}
+
+void PhaseReport::print() const
+{
+    std::lock_guard<std::mutex> guard(mutex_report);
+    if (settings.verbose >= 2)
+    {
+        std::ostringstream table{};
+        table << std::fixed << std::setprecision(3) << "Phase report:\n"
+              << std::left << std::setw(22) << "phase" << std::right << std::setw(12) << "wall[s]"
+              << std::setw(12) << "cpu[s]" << std::setw(16) << "peak rss[kB]";
+        if (counters)
+        {
+            for (char const * event : perf_event_names)
+                table << std::setw(16) << event;
+            table << std::setw(8) << "ipc";
+        }
+        table << "\n";
+        for (Phase const & phase : phases)
+        {
+            table << std::left << std::setw(22) << phase.name << std::right << std::setw(12) << phase.wall
+                  << std::setw(12) << phase.cpu << std::setw(16) << phase.peak_rss_kb;
+            if (counters)
+                print_perf_columns(table, phase.perf);
+            table << "\n";
+        }
+        for (TaskPerf const & task : task_perf)
+        {
+            table << std::left << std::setw(22) << task.name << std::right << std::setw(12) << task.tasks
+                  << std::setw(28) << "tasks";
+            print_perf_columns(table, task.perf);
+            table << "\n";
+        }
+        for (auto const & [name, bytes] : memory)
+            table << std::left << std::setw(22) << name << std::right << std::setw(12) << bytes << " bytes\n";
+        if (counters && !counters->available())
+            table << "Hardware counters are not available on this system.\n";
+        logger(2, table.str());
+    }
+
+    if (settings.report_file.empty())
+        return;
+
+    std::ofstream ofs{settings.report_file};
+    if (!ofs)
+        throw seqan3::file_open_error{"Could not write the phase report ==> " + settings.report_file.string()};
+
+    ofs << "{\n  \"phases\": [";
+    for (size_t idx = 0; idx < phases.size(); ++idx)
+    {
+        ofs << (idx == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << phases[idx].name << "\""
+            << ", \"wall_time\": " << phases[idx].wall
+            << ", \"cpu_time\": " << phases[idx].cpu
+            << ", \"peak_rss_kb\": " << phases[idx].peak_rss_kb;
+        if (counters)
+        {
+            ofs << ", \"counters\": ";
+            print_perf_json(ofs, phases[idx].perf);
+        }
+        ofs << "}";
+    }
+    ofs << "\n  ],\n  \"task_counters\": {";
+    for (size_t idx = 0; idx < task_perf.size(); ++idx)
+    {
+        ofs << (idx == 0 ? "\n" : ",\n") << "    \"" << task_perf[idx].name << "\": {\"tasks\": "
+            << task_perf[idx].tasks << ", \"counters\": ";
+        print_perf_json(ofs, task_perf[idx].perf);
+        ofs << "}";
+    }
+    ofs << "\n  },\n  \"memory\": {";
+    for (size_t idx = 0; idx < memory.size(); ++idx)
+        ofs << (idx == 0 ? "\n" : ",\n") << "    \"" << memory[idx].first << "\": " << memory[idx].second;
+    ofs << "\n  },\n  \"peak_rss_kb\": " << process_peak_rss() << "\n}\n";
+}
+
+} // namespace mars
@@ -0,0 +1,168 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "perf_counters.hpp"
+
+namespace mars
+{
+
+/*!
+ * \brief Collects the wall time, CPU time and peak memory of the phases of a MaRs run.
+ *
+ * \details
+ * The CPU time is measured for the whole process, thus phases that run concurrently (e.g. reading the genome and
+ * analysing the alignment) account for each other's work. The peak resident set size is the maximum that the
+ * process has reached until the end of the phase. If hardware counters are enabled, the report also contains the
+ * counted events of the whole process for each phase, and the events of the calling thread for selected tasks.
+ */
+class PhaseReport
+{
+private:
+    //! \brief The measurements of a single phase.
+    struct Phase
+    {
+        std::string name; //!< The name of the phase.
+        double wall; //!< The elapsed time in seconds.
+        double cpu; //!< The CPU time of the process in seconds.
+        long peak_rss_kb; //!< The peak resident set size at the end of the phase.
+        PerfValues perf; //!< The hardware events of the process during the phase.
+    };
+
+    //! \brief The accumulated hardware events of a kind of task.
+    struct TaskPerf
+    {
+        char const * name; //!< The name of the task.
+        size_t tasks; //!< The number of measured tasks.
+        PerfValues perf; //!< The hardware events of the tasks.
+    };
+
+    //! \brief The mutex for concurrent recording.
+    mutable std::mutex mutex_report;
+    //! \brief The measured phases in the order of completion.
+    std::vector<Phase> phases;
+    //! \brief The memory sizes of the main data structures.
+    std::vector<std::pair<std::string, size_t>> memory;
+    //! \brief The hardware events of the tasks.
+    std::vector<TaskPerf> task_perf;
+    //! \brief The hardware counters of the process, or nullptr if they are disabled.
+    std::unique_ptr<PerfCounters> counters;
+
+public:
+    //! \brief Measures a phase from construction until destruction.
+    class Timer
+    {
+    private:
+        //! \brief The report that receives the measurement.
+        PhaseReport * report;
+        //! \brief The name of the phase.
+        char const * name;
+        //! \brief The start time.
+        std::chrono::steady_clock::time_point wall_start;
+        //! \brief The start time in the trace, if tracing is enabled.
+        uint64_t trace_start;
+        //! \brief The CPU time of the process at the start.
+        double cpu_start;
+        //! \brief The hardware counters of the process at the start.
+        PerfValues perf_start;
+
+    public:
+        /*!
+         * \brief Start the measurement of a phase.
+         * \param report The report that receives the measurement.
+         * \param name The name of the phase, a string literal.
+         */
+        Timer(PhaseReport * report, char const * name);
+
+        Timer(Timer const &) = delete;
+        Timer & operator=(Timer const &) = delete;
+
+        //! \brief Move constructor that takes over the measurement.
+        Timer(Timer && other) noexcept;
+
+        //! \brief Destructor that records the phase, unless it has been stopped before.
+        ~Timer()
+        {
+            stop();
+        }
+
+        //! \brief Record the phase and end the measurement.
+        void stop();
+    };
+
+    /*!
+     * \brief Start measuring a phase.
+     * \param name The name of the phase, a string literal.
+     * \return A timer that records the phase when it goes out of scope.
+     */
+    Timer measure(char const * name)
+    {
+        return Timer{this, name};
+    }
+
+    //! \brief Measures the hardware events of a task on the calling thread from construction until destruction.
+    class TaskCounter
+    {
+    private:
+        //! \brief The name of the task, or nullptr if the counters are disabled.
+        char const * name;
+        //! \brief The hardware counters of the thread at the start.
+        PerfValues perf_start;
+
+    public:
+        /*!
+         * \brief Start the measurement of a task.
+         * \param name The name of the task, a string literal.
+         */
+        explicit TaskCounter(char const * name);
+
+        TaskCounter(TaskCounter const &) = delete;
+        TaskCounter & operator=(TaskCounter const &) = delete;
+
+        //! \brief Destructor that records the task.
+        ~TaskCounter();
+    };
+
+    /*!
+     * \brief Open the hardware counters of the process. Must be called before the thread pool is created,
+     *        because only threads that are started afterwards are counted.
+     * \return Whether at least one hardware event is available.
+     */
+    bool enable_counters();
+
+    //! \brief Whether the hardware counters are enabled.
+    bool counters_enabled() const
+    {
+        return counters != nullptr;
+    }
+
+    //! \brief Whether the memory sizes should be computed, i.e. the report is printed or stored.
+    bool enabled() const;
+
+    /*!
+     * \brief Record the memory size of a data structure.
+     * \param name The name of the data structure.
+     * \param bytes The size in bytes.
+     */
+    void add_memory(std::string name, size_t bytes);
+
+    //! \brief Print the report at verbosity level 2 and write it to the report file, if one is given.
+    void print() const;
+};
+
+//! \brief The phase report of the MaRs run.
+extern PhaseReport phase_report;
+
+} // namespace mars
@@ -10,6 +10,7 @@
 #include <array>
 #include <cmath>
 #include <set>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
@@ -39,7 +40,7 @@ private:
     static constexpr size_t const size{seqan3::alphabet_size<alph_type>};
 
     //! \brief Convert wildcard characters into their components.
-    static std::string compose(char chr)
+    static constexpr std::string_view compose(char chr)
     {
         switch (chr)
         {
@@ -124,6 +125,7 @@ public:
      * \brief Increase the character count (by 1 in total).
      * \tparam ext_alph_type The extended alphabet type that may contain wildcards; must be a nucleotide alphabet.
      * \param chr The character of which the count is incremented.
+     * \param count The number of occurrences of the character.
      *
      * \details
      * If a wildcard is given, the counts of all matching characters are increased by the same fraction
@@ -134,11 +136,11 @@ public:
         requires seqan3::writable_alphabet<alph_type> &&
                  (seqan3::alphabet_size<ext_alph_type> > seqan3::alphabet_size<alph_type>)
     //!\endcond
-    void increment(ext_alph_type chr)
+    void increment(ext_alph_type chr, uint32_t count = 1)
     {
-        std::string composition = compose(chr.to_char());
+        std::string_view const composition = compose(chr.to_char());
         for (char x : composition)
-            tally[alph_type{}.assign_char(x).to_rank()] += one/composition.size();
+            tally[alph_type{}.assign_char(x).to_rank()] += count * (one / composition.size());
     }
 
     /*!
@@ -162,6 +164,7 @@ public:
      * \tparam ext_alph_type The extended alphabet type that may contain wildcards; must be a nucleotide alphabet.
      * \param chr1 The first character of the bi-character.
      * \param chr2 The second character of the bi-character.
+     * \param count The number of occurrences of the bi-character.
      *
      * \details
      * If a wildcard is given, the counts of all matching characters are increased by the same fraction
@@ -171,14 +174,14 @@ public:
     //!\cond
         requires BiAlphabetConcept<alph_type>
     //!\endcond
-    void increment(ext_alph_type chr1, ext_alph_type chr2)
+    void increment(ext_alph_type chr1, ext_alph_type chr2, uint32_t count = 1)
     {
-        std::string composition1 = compose(seqan3::to_char(chr1));
-        std::string composition2 = compose(seqan3::to_char(chr2));
+        std::string_view const composition1 = compose(seqan3::to_char(chr1));
+        std::string_view const composition2 = compose(seqan3::to_char(chr2));
         size_t len = composition1.size() * composition2.size();
         for (char x1 : composition1)
             for (char x2 : composition2)
-                tally[alph_type{}.assign_chars(x1, x2).to_rank()] += one/len;
+                tally[alph_type{}.assign_chars(x1, x2).to_rank()] += count * (one / len);
     }
 
     /*!
@@ -0,0 +1,243 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+#include "result_writer.hpp"
+
+namespace mars
+{
+
+ResultFormat result_format(std::filesystem::path const & filepath)
+{
+    std::string extension = filepath.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [] (unsigned char chr) { return std::tolower(chr); });
+    if (extension == ".bed")
+        return ResultFormat::bed;
+    if (extension == ".gff" || extension == ".gff3")
+        return ResultFormat::gff3;
+    if (extension == ".jsonl" || extension == ".ndjson")
+        return ResultFormat::jsonl;
+    return ResultFormat::tsv;
+}
+
+ResultWriter::ResultWriter(std::ostream & out, ResultFormat format, std::vector<std::string> const & names) :
+    out{out},
+    format{format},
+    names{names}
+{
+    buffer.reserve(chunk_size + 4096);
+    pending.reserve(chunk_size + 4096);
+    thread = std::thread{&ResultWriter::run, this};
+
+    if (format == ResultFormat::tsv)
+    {
+        std::string_view const first_column{"sequence name"};
+        append(first_column);
+        buffer.append(35 - first_column.size(), ' ');
+        append("\tindex\tpos\tend\tqlen\tn\tscore\te-value\n");
+    }
+    else if (format == ResultFormat::gff3)
+    {
+        append("##gff-version 3\n");
+    }
+}
+
+void ResultWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_buffer);
+    while (true)
+    {
+        cv_buffer.wait(lock, [this] { return has_pending || closed; });
+        if (!has_pending)
+            break;
+
+        // The calling thread does not touch the pending buffer until has_pending is reset.
+        lock.unlock();
+        out.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+        lock.lock();
+        has_pending = false;
+        cv_buffer.notify_all();
+    }
+}
+
+void ResultWriter::hand_over()
+{
+    std::unique_lock<std::mutex> lock(mutex_buffer);
+    cv_buffer.wait(lock, [this] { return !has_pending; });
+    std::swap(buffer, pending);
+    has_pending = true;
+    cv_buffer.notify_all();
+    buffer.clear();
+}
+
+void ResultWriter::append(size_t value)
+{
+    char str[24];
+    auto const result = std::to_chars(str, str + sizeof(str), value);
+    buffer.append(str, result.ptr);
+}
+
+void ResultWriter::append(double value)
+{
+    char str[32];
+    int const len = std::snprintf(str, sizeof(str), "%g", value);
+    buffer.append(str, std::min<size_t>(len, sizeof(str) - 1));
+}
+
+void ResultWriter::append_json(std::string_view value)
+{
+    buffer.push_back('"');
+    for (char chr : value)
+    {
+        if (chr == '"' || chr == '\\')
+        {
+            buffer.push_back('\\');
+            buffer.push_back(chr);
+        }
+        else if (static_cast<unsigned char>(chr) < 0x20)
+        {
+            char str[8];
+            std::snprintf(str, sizeof(str), "\\u%04x", static_cast<unsigned>(chr));
+            buffer.append(str);
+        }
+        else
+        {
+            buffer.push_back(chr);
+        }
+    }
+    buffer.push_back('"');
+}
+
+void ResultWriter::append_gff3(std::string_view value)
+{
+    // The GFF3 specification allows only these characters unescaped in the seqid column.
+    std::string_view const allowed{".:^*$@!+_?-|"};
+    for (char chr : value)
+    {
+        if (std::isalnum(static_cast<unsigned char>(chr)) || allowed.find(chr) != std::string_view::npos)
+        {
+            buffer.push_back(chr);
+        }
+        else
+        {
+            char str[4];
+            std::snprintf(str, sizeof(str), "%%%02X", static_cast<unsigned>(static_cast<unsigned char>(chr)));
+            buffer.append(str);
+        }
+    }
+}
+
+void ResultWriter::write(MotifLocation const & loc)
+{
+    ++rank;
+    std::string const & name = names[loc.sequence];
+    switch (format)
+    {
+        case ResultFormat::tsv:
+            append(name);
+            if (name.size() < 35)
+                buffer.append(35 - name.size(), ' ');
+            append("\t");
+            append(loc.sequence);
+            append("\t");
+            append(loc.position_start);
+            append("\t");
+            append(loc.position_end);
+            append("\t");
+            append(loc.query_length);
+            append("\t");
+            append(static_cast<size_t>(loc.num_stemloops));
+            append("\t");
+            append(static_cast<double>(loc.score));
+            append("\t");
+            append(loc.evalue);
+            break;
+
+        case ResultFormat::bed:
+            // BED scores are integers between 0 and 1000.
+            append(name);
+            append("\t");
+            append(loc.position_start);
+            append("\t");
+            append(loc.position_end);
+            append("\tmars");
+            append(rank);
+            append("\t");
+            append(static_cast<size_t>(std::clamp(std::lround(loc.score), 0l, 1000l)));
+            append("\t+");
+            break;
+
+        case ResultFormat::gff3:
+            append_gff3(name);
+            append("\tMaRs\tmatch\t");
+            append(loc.position_start + 1);
+            append("\t");
+            append(loc.position_end);
+            append("\t");
+            append(static_cast<double>(loc.score));
+            append("\t+\t.\tID=mars");
+            append(rank);
+            append(";evalue=");
+            append(loc.evalue);
+            append(";stemloops=");
+            append(static_cast<size_t>(loc.num_stemloops));
+            append(";query_length=");
+            append(loc.query_length);
+            break;
+
+        case ResultFormat::jsonl:
+            append("{\"sequence\":");
+            append_json(name);
+            append(",\"index\":");
+            append(loc.sequence);
+            append(",\"start\":");
+            append(loc.position_start);
+            append(",\"end\":");
+            append(loc.position_end);
+            append(",\"query_length\":");
+            append(loc.query_length);
+            append(",\"stemloops\":");
+            append(static_cast<size_t>(loc.num_stemloops));
+            append(",\"score\":");
+            append(static_cast<double>(loc.score));
+            append(",\"evalue\":");
+            if (std::isfinite(loc.evalue))
+                append(loc.evalue);
+            else
+                append("null");
+            append("}");
+            break;
+    }
+    buffer.push_back('\n');
+
+    if (buffer.size() >= chunk_size)
+        hand_over();
+}
+
+void ResultWriter::close()
+{
+    if (!thread.joinable())
+        return;
+
+    if (!buffer.empty())
+        hand_over();
+    {
+        std::lock_guard<std::mutex> guard(mutex_buffer);
+        closed = true;
+        cv_buffer.notify_all();
+    }
+    thread.join();
+    out.flush();
+}
+
+} // namespace mars
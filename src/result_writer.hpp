@@ -0,0 +1,130 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <seqan3/std/filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "location.hpp"
+
+namespace mars
+{
+
+//! \brief The file formats for the resulting locations.
+enum class ResultFormat : uint8_t
+{
+    tsv,  //!< The tab-separated MaRs table with a header line.
+    bed,  //!< BED6 with 0-based, half-open coordinates.
+    gff3, //!< GFF3 with 1-based, closed coordinates.
+    jsonl //!< One JSON object per line.
+};
+
+/*!
+ * \brief Determine the result format from the file extension.
+ * \param filepath The output file, where an empty path denotes stdout.
+ * \return BED for .bed, GFF3 for .gff and .gff3, JSON lines for .jsonl and .ndjson, and otherwise the MaRs table.
+ */
+ResultFormat result_format(std::filesystem::path const & filepath);
+
+/*!
+ * \brief Formats MotifLocations and writes them on a background thread.
+ *
+ * \details
+ * The rows are formatted into a large buffer without any stream formatting. A full buffer is handed over to a
+ * background thread that writes it to the stream, while the calling thread continues to fill the next buffer.
+ * The stream is flushed only once at the end.
+ */
+class ResultWriter
+{
+private:
+    //! \brief The buffer size at which the formatted rows are handed over to the background thread.
+    static constexpr size_t chunk_size{1ul << 20};
+
+    //! \brief The output stream.
+    std::ostream & out;
+    //! \brief The output format.
+    ResultFormat format;
+    //! \brief The sequence names of the genome.
+    std::vector<std::string> const & names;
+    //! \brief The buffer that is being filled.
+    std::string buffer{};
+    //! \brief The buffer that is being written, or waiting for the background thread.
+    std::string pending{};
+    //! \brief Whether the pending buffer contains data that has not been written yet.
+    bool has_pending{false};
+    //! \brief Whether the writer has been closed.
+    bool closed{false};
+    //! \brief The number of written locations.
+    size_t rank{0};
+    //! \brief The mutex for handing over the buffers.
+    std::mutex mutex_buffer;
+    //! \brief Signals changes of has_pending and closed.
+    std::condition_variable cv_buffer;
+    //! \brief The background thread that writes the pending buffers.
+    std::thread thread;
+
+    //! \brief Write the pending buffers until the writer is closed.
+    void run();
+
+    //! \brief Hand over the current buffer to the background thread, waiting until the previous one is written.
+    void hand_over();
+
+    //! \brief Append an unsigned integer to the buffer.
+    void append(size_t value);
+
+    //! \brief Append a floating point number to the buffer, in the default format of output streams.
+    void append(double value);
+
+    //! \brief Append a string to the buffer.
+    void append(std::string_view value)
+    {
+        buffer.append(value);
+    }
+
+    //! \brief Append a string as a JSON string literal to the buffer.
+    void append_json(std::string_view value);
+
+    //! \brief Append a string as a percent-encoded GFF3 sequence id to the buffer.
+    void append_gff3(std::string_view value);
+
+public:
+    /*!
+     * \brief Start the background thread and write the header of the format.
+     * \param out The output stream.
+     * \param format The output format.
+     * \param names The sequence names of the genome.
+     */
+    ResultWriter(std::ostream & out, ResultFormat format, std::vector<std::string> const & names);
+
+    ResultWriter(ResultWriter const &) = delete;
+    ResultWriter & operator=(ResultWriter const &) = delete;
+
+    //! \brief Destructor that closes the writer.
+    ~ResultWriter()
+    {
+        close();
+    }
+
+    /*!
+     * \brief Format a location and append it to the output.
+     * \param loc The location, which gets the next rank.
+     */
+    void write(MotifLocation const & loc);
+
+    //! \brief Write the remaining rows, flush the stream and stop the background thread.
+    void close();
+};
+
+} // namespace mars
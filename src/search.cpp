@@ -7,41 +7,86 @@
 
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <type_traits>
+#include <variant>
 
+#include <seqan3/io/exception.hpp>
 #include <seqan3/utility/parallel/detail/latch.hpp>
 
+#include "phase_report.hpp"
 #include "search.hpp"
 #include "settings.hpp"
+#include "trace.hpp"
 
 namespace mars
 {
 
-bool SearchInfo::append_loop(std::pair<float, seqan3::rna4> item, bool left)
+SearchProgram::SearchProgram(Stemloop const & stemloop)
 {
-    bool succ;
-    seqan3::bi_fm_index_cursor<Index> new_cur(history.back().second);
+    for (auto const & element : stemloop.elements)
+    {
+        std::visit([this] (auto const & elem)
+        {
+            uint32_t const offset = size();
+            for (size_t idx = 0; idx < elem.prio.size(); ++idx)
+            {
+                SearchStep & step = steps.emplace_back();
 
-    if (left)
-        succ = new_cur.extend_left(item.second);
-    else
-        succ = new_cur.extend_right(item.second);
+                // the options in the order of descending score
+                step.options_begin = static_cast<uint32_t>(options.size());
+                for (auto opt = elem.prio[idx].crbegin(); opt != elem.prio[idx].crend(); ++opt)
+                {
+                    if constexpr (std::is_same_v<std::decay_t<decltype(elem)>, LoopElement>)
+                    {
+                        int8_t const rank = static_cast<int8_t>(opt->second.to_rank());
+                        options.push_back({opt->first, elem.leftsided ? rank : int8_t{-1},
+                                           elem.leftsided ? int8_t{-1} : rank});
+                    }
+                    else
+                    {
+                        auto to_rank = [] (seqan3::gapped<seqan3::rna4> chr)
+                        {
+                            return chr == seqan3::gap()
+                                ? int8_t{-1}
+                                : static_cast<int8_t>(chr.convert_unsafely_to<seqan3::rna4>().to_rank());
+                        };
+                        options.push_back({opt->first, to_rank(opt->second.first()), to_rank(opt->second.second())});
+                    }
+                }
+                step.options_end = static_cast<uint32_t>(options.size());
 
-    if (succ)
-        history.emplace_back(history.back().first + item.first, new_cur);
-    return succ;
+                // the gaps as absolute step indices, which may point to the beginning of the next element
+                step.jumps_begin = static_cast<uint32_t>(jumps.size());
+                for (auto const & len_num : elem.gaps[idx])
+                    jumps.push_back(static_cast<uint32_t>(offset + idx + len_num.first));
+                step.jumps_end = static_cast<uint32_t>(jumps.size());
+                std::sort(jumps.begin() + step.jumps_begin, jumps.end());
+            }
+        }, element);
+    }
+
+    // accumulate the best option of each step from the end, where skipped steps and negative options add nothing
+    potentials.assign(steps.size() + 1, 0.f);
+    for (size_t idx = steps.size(); idx > 0; --idx)
+    {
+        SearchStep const & step = steps[idx - 1];
+        float const best = step.options_begin < step.options_end ? options[step.options_begin].score : 0.f;
+        potentials[idx - 1] = potentials[idx] + std::max(0.f, best);
+    }
 }
 
-bool SearchInfo::append_stem(ScoredRnaPair stem_item)
+bool SearchInfo::append(SearchOption const & opt)
 {
     seqan3::bi_fm_index_cursor<Index> new_cur(history.back().second);
     bool succ = true;
-    if (stem_item.second.first() != seqan3::gap())
-        succ = new_cur.extend_left(stem_item.second.first().convert_unsafely_to<seqan3::rna4>());
-    if (succ && stem_item.second.second() != seqan3::gap())
-        succ = new_cur.extend_right(stem_item.second.second().convert_unsafely_to<seqan3::rna4>());
+    if (opt.left >= 0)
+        succ = new_cur.extend_left(seqan3::rna4{}.assign_rank(opt.left));
+    if (succ && opt.right >= 0)
+        succ = new_cur.extend_right(seqan3::rna4{}.assign_rank(opt.right));
     if (succ)
-        history.emplace_back(history.back().first + stem_item.first, new_cur);
+        history.emplace_back(history.back().first + opt.score, new_cur);
     return succ;
 }
 
@@ -60,107 +105,177 @@ bool SearchInfo::xdrop() const
         return history.back().first < history[history.size() - settings.xdrop].first;
 }
 
-void SearchInfo::compute_hits() const
+bool SearchInfo::hopeless(float potential) const
+{
+    // the tolerance covers rounding differences between the accumulated scores and the potentials
+    return history.back().first + potential < min_score - 1e-3f;
+}
+
+void SearchInfo::compute_hits()
 {
     auto score = history.back().first;
     auto cur = history.back().second;
     auto const len = static_cast<long long>(cur.query_length());
-    if (len >= stemloop.length.first && len > 5 && score > 0)
+    if (len >= stemloop.length.first && len > 5 && score > 0 && score >= min_score)
     {
+        ++stats.located_ranges;
         std::lock_guard<std::mutex> guard(queries.mutex);
         queries.futures.push_back(pool->submit([cur, store = &hits, off = stemloop.bounds.first, len,
-                                                uid = stemloop.uid, score]
+                                                uid = stemloop.uid, score, seq_off = sequence_offset]
         {
+            TraceScope const trace{"locate"};
+            PhaseReport::TaskCounter const counter{"locate tasks"};
             for (auto && [seq, pos] : cur.locate())
-                store->push({static_cast<long long>(pos) - off, len, uid, score}, seq);
+                store->push({static_cast<long long>(pos) - off, len, uid, score}, seq + seq_off);
         }));
     }
 }
 
-template <typename MotifElement>
-void recurse_search(SearchInfo & info, ElementIter elem_it, Position idx)
+void SearchInfo::search(SearchProgram const & program)
 {
-    if (info.xdrop())
-        return;
-
-    auto const & elem = std::get<MotifElement>(*elem_it);
+    // A frame represents a node of the search tree: the step and the next option or gap jump to be tried.
+    struct Frame
+    {
+        uint32_t step;
+        uint32_t option;
+        uint32_t jump;
+        bool extended; // whether the query has been extended with the previous option
+    };
+    std::vector<Frame> stack{};
+    stack.reserve(program.size() + 1);
 
-    if (idx == elem.prio.size())
+    auto enter = [this, &program, &stack] (uint32_t step)
     {
-        auto const next = elem_it + 1;
-        if (next == info.stemloop_end())
-            info.compute_hits();
-        else if (std::holds_alternative<StemElement>(*next))
-            recurse_search<StemElement>(info, next, 0);
+        if (xdrop())
+        {
+            ++stats.xdrop_prunes;
+            return;
+        }
+        if (hopeless(program.potential(step)))
+        {
+            ++stats.score_prunes;
+            return;
+        }
+        ++stats.nodes;
+        if (step == program.size())
+            compute_hits();
         else
-            recurse_search<LoopElement>(info, next, 0);
-        return;
-    }
+            stack.push_back({step, program.step(step).options_begin, program.step(step).jumps_begin, false});
+    };
 
-    auto const & prio = elem.prio[idx];
-
-    // try to extend the pattern
-    for (auto opt = prio.crbegin(); opt != prio.crend(); ++opt)
+    enter(0);
+    while (!stack.empty())
     {
-        bool succ;
-        if constexpr (std::is_same_v<MotifElement, LoopElement>)
-            succ = info.append_loop(*opt, elem.leftsided);
-        else
-            succ = info.append_stem(*opt);
+        Frame & frame = stack.back();
+        SearchStep const & step = program.step(frame.step);
+        if (frame.extended)
+        {
+            backtrack();
+            frame.extended = false;
+        }
 
-        if (succ)
+        if (frame.option < step.options_end) // try to extend the pattern
+        {
+            ++stats.extensions;
+            frame.extended = append(program.option(frame.option++));
+            if (frame.extended)
+                enter(frame.step + 1); // invalidates frame
+            else
+                ++stats.failed_extensions;
+        }
+        else if (frame.jump < step.jumps_end) // try gaps
+        {
+            ++stats.gap_branches;
+            enter(program.jump(frame.jump++)); // invalidates frame
+        }
+        else
         {
-            recurse_search<MotifElement>(info, elem_it, idx + 1);
-            info.backtrack();
+            stack.pop_back();
         }
     }
-
-    // try gaps
-    for (auto const & len_num : elem.gaps[idx])
-        recurse_search<MotifElement>(info, elem_it, idx + len_num.first);
 }
 
-void find_motif(mars::BiDirectionalIndex const & index, Motif const & motif)
+std::vector<SearchStats> search_hits(BiDirectionalIndex const & index,
+                                     Motif const & motif,
+                                     StemloopHitStore & hits,
+                                     size_t db_len)
 {
-    StemloopHitStore hits(index.get_names().size());
+    std::vector<SearchStats> stats(motif.size());
 
     logger(1, "Stem loop search...");
+    PhaseReport::Timer search_timer = phase_report.measure("search");
     assert(motif.size() <= UINT8_MAX);
     uint8_t const num_motifs = motif.size();
 
+    // The calibrated stemloops skip the hits that are expected by chance more often than the tolerated e-value.
+    std::vector<float> min_scores(num_motifs, 0.f);
+    if (!std::isnan(settings.search_evalue))
+        for (size_t idx = 0; idx < num_motifs; ++idx)
+            min_scores[idx] = motif[idx].calibration.min_score(db_len, settings.search_evalue);
+
+    // Each stemloop is searched in each index segment, and the hits are mapped to global sequence numbers.
+    std::vector<IndexSegment> const & segments = index.get_segments();
+    size_t const num_tasks = num_motifs * segments.size();
+    std::vector<SearchStats> task_stats(num_tasks);
     ConcurrentFutureVector queries;
     std::vector<std::future<void>> search_tasks;
-    seqan3::detail::latch lat{num_motifs};
-    for (size_t idx = 0; idx < num_motifs; ++idx)
+    seqan3::detail::latch lat{static_cast<ptrdiff_t>(num_tasks)};
+    for (size_t tidx = 0; tidx < num_tasks; ++tidx)
     {
-        search_tasks.push_back(pool->submit([&index, &motif, &hits, &queries, &lat, idx]
+        search_tasks.push_back(pool->submit([&index, &segments, &motif, &hits, &queries, &lat, &task_stats,
+                                             &min_scores, tidx, num_motifs]
         {
-            // initiate recursive search
-            SearchInfo info(index.raw(), motif[idx], hits, queries);
-            auto const iter = motif[idx].elements.cbegin();
+            TraceScope const trace{"search stemloop"};
+            PhaseReport::TaskCounter const counter{"search tasks"};
+            size_t const idx = tidx % num_motifs;
+            IndexSegment const & segment = segments[tidx / num_motifs];
+            // compile the stemloop and initiate the search in the index replica of this thread's NUMA node
+            SearchProgram const program{motif[idx]};
+            SearchInfo info(index.local_index(tidx / num_motifs), motif[idx], hits, queries, segment.first_sequence,
+                            min_scores[idx]);
             lat.wait();
-            if (std::holds_alternative<LoopElement>(*iter))
-                recurse_search<LoopElement>(info, iter, 0);
-            else
-                recurse_search<StemElement>(info, iter, 0);
+            auto const tm_search = std::chrono::steady_clock::now();
+            info.search(program);
+            task_stats[tidx] = info.statistics();
+            task_stats[tidx].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tm_search)
+                                       .count();
             logger(1, " " << (idx + 1));
         }));
         lat.arrive();
     }
     for (auto & future : search_tasks)
         future.wait();
+    search_timer.stop();
+    for (size_t tidx = 0; tidx < num_tasks; ++tidx)
+        stats[tidx % num_motifs] += task_stats[tidx];
     logger(1, "\nWaiting for " << queries.futures.size() << " queries to complete...");
     std::chrono::steady_clock::time_point tm0 = std::chrono::steady_clock::now();
+    PhaseReport::Timer locate_timer = phase_report.measure("locate");
     for (auto & future : queries.futures)
         future.wait();
     queries.futures.clear();
+    locate_timer.stop();
     auto const sec = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - tm0).count();
     logger(1, " finished (" << sec << "s)." << std::endl);
 
-    // collect the hits asynchronously and print
-    MotifLocationStore locations(index.get_names());
+    // count the hits of each stemloop
     size_t const seqnum = index.get_names().size();
-    size_t const db_len = index.raw().size() - (seqnum > 1 ? seqnum : 2);
+    for (size_t sidx = 0; sidx < seqnum; ++sidx)
+        for (StemloopHit const & hit : hits.get(sidx))
+            ++stats[hit.midx].hits;
+    if (phase_report.enabled())
+        phase_report.add_memory("hit store", hits.memory_size());
+    return stats;
+}
+
+void merge_all_hits(MotifLocationStore & locations, StemloopHitStore & hits, Motif const & motif, size_t db_len,
+                    size_t seqnum)
+{
+    if (seqnum == 0)
+        return;
+
+    // collect the hits asynchronously
+    PhaseReport::Timer const merge_timer = phase_report.measure("merge");
     size_t const delta = (seqnum - 1) / settings.nthreads + 1; // ceil
     std::vector<std::future<void>> futures;
     for (size_t sidx = 0; sidx < seqnum; sidx += delta)
@@ -170,8 +285,70 @@ void find_motif(mars::BiDirectionalIndex const & index, Motif const & motif)
     }
     for (auto & future : futures)
         future.wait();
+    if (phase_report.enabled())
+        phase_report.add_memory("location store", locations.capacity() * sizeof(MotifLocation));
+}
+
+std::vector<SearchStats> search_motif(BiDirectionalIndex const & index,
+                                      Motif const & motif,
+                                      MotifLocationStore & locations)
+{
+    StemloopHitStore hits(index.get_names().size());
+    size_t const db_len = index.text_length();
+    std::vector<SearchStats> stats = search_hits(index, motif, hits, db_len);
+    merge_all_hits(locations, hits, motif, db_len, index.get_names().size());
+    return stats;
+}
 
+void find_motif(BiDirectionalIndex const & index, Motif const & motif)
+{
+    MotifLocationStore locations(index.get_names());
+    std::vector<SearchStats> const stats = search_motif(index, motif, locations);
+    PhaseReport::Timer const timer = phase_report.measure("output");
     locations.print();
+    store_search_stats(motif, stats);
+}
+
+void store_search_stats(Motif const & motif, std::vector<SearchStats> const & stats)
+{
+    if (settings.stats_file.empty())
+        return;
+
+    std::ofstream ofs{settings.stats_file};
+    if (!ofs)
+        throw seqan3::file_open_error{"Could not write the search statistics ==> " + settings.stats_file.string()};
+
+    auto print = [&ofs] (SearchStats const & stat)
+    {
+        ofs << "\"seconds\": " << stat.seconds
+            << ", \"nodes\": " << stat.nodes
+            << ", \"extensions\": " << stat.extensions
+            << ", \"failed_extensions\": " << stat.failed_extensions
+            << ", \"xdrop_prunes\": " << stat.xdrop_prunes
+            << ", \"score_prunes\": " << stat.score_prunes
+            << ", \"gap_branches\": " << stat.gap_branches
+            << ", \"located_ranges\": " << stat.located_ranges
+            << ", \"hits\": " << stat.hits;
+    };
+
+    SearchStats total{};
+    ofs << "{\n  \"stemloops\": [";
+    for (size_t idx = 0; idx < stats.size(); ++idx)
+    {
+        Stemloop const & stemloop = motif[idx];
+        ofs << (idx == 0 ? "\n" : ",\n")
+            << "    {\"uid\": " << +stemloop.uid
+            << ", \"bounds\": [" << stemloop.bounds.first << ", " << stemloop.bounds.second << "]"
+            << ", \"length\": [" << stemloop.length.first << ", " << stemloop.length.second << "], ";
+        print(stats[idx]);
+        ofs << "}";
+
+        total += stats[idx];
+    }
+    ofs << "\n  ],\n  \"total\": {";
+    print(total);
+    ofs << "}\n}\n";
+    logger(1, "Stored the search statistics ==> " << settings.stats_file << std::endl);
 }
 
 void merge_hits(MotifLocationStore & locations,
@@ -181,6 +358,7 @@ void merge_hits(MotifLocationStore & locations,
                 size_t sidx_begin,
                 size_t sidx_end)
 {
+    TraceScope const trace{"merge hits"};
     for (size_t sidx = sidx_begin; sidx < sidx_end; ++sidx)
     {
         std::vector<StemloopHit> & hitvec = hits.get(sidx);
@@ -11,9 +11,9 @@
 #include <cmath>
 #include <cstdint>
 #include <future>
+#include <mutex>
 #include <set>
 #include <tuple>
-#include <variant>
 #include <vector>
 
 #include <seqan3/alphabet/concept.hpp>
@@ -26,9 +26,6 @@
 namespace mars
 {
 
-//! \brief The type of a stemloop's element iterator.
-typedef typename std::vector<std::variant<LoopElement, StemElement>>::const_iterator ElementIter;
-
 //! \brief A storage for futures with concurrent access.
 struct ConcurrentFutureVector
 {
@@ -36,6 +33,112 @@ struct ConcurrentFutureVector
     std::mutex mutex; //!< A mutex for concurrent access to `futures`.
 };
 
+//! \brief An option for extending the query: a score and the characters to append on either side.
+struct SearchOption
+{
+    float score; //!< The score of the option.
+    int8_t left; //!< The rank of the rna4 character to be appended on the 5' side, or -1.
+    int8_t right; //!< The rank of the rna4 character to be appended on the 3' side, or -1.
+};
+
+//! \brief A single position of a stemloop in the search program.
+struct SearchStep
+{
+    uint32_t options_begin; //!< The first option of this step.
+    uint32_t options_end; //!< One after the last option of this step.
+    uint32_t jumps_begin; //!< The first gap jump of this step.
+    uint32_t jumps_end; //!< One after the last gap jump of this step.
+};
+
+//! \brief Statistics about the search of a single stemloop.
+struct SearchStats
+{
+    size_t nodes{0}; //!< The number of visited search tree nodes.
+    size_t extensions{0}; //!< The number of attempted extensions of the query.
+    size_t failed_extensions{0}; //!< The number of extensions that did not occur in the index.
+    size_t xdrop_prunes{0}; //!< The number of nodes that were discarded by the xdrop condition.
+    size_t score_prunes{0}; //!< The number of nodes that were discarded, because they cannot reach the minimum score.
+    size_t gap_branches{0}; //!< The number of gap jumps that were taken.
+    size_t located_ranges{0}; //!< The number of suffix array ranges that were located.
+    size_t hits{0}; //!< The number of hits that were produced.
+    double seconds{0}; //!< The time for traversing the search tree, excluding the asynchronous location.
+
+    //! \brief Accumulate the statistics of another search.
+    SearchStats & operator+=(SearchStats const & other)
+    {
+        nodes += other.nodes;
+        extensions += other.extensions;
+        failed_extensions += other.failed_extensions;
+        xdrop_prunes += other.xdrop_prunes;
+        score_prunes += other.score_prunes;
+        gap_branches += other.gap_branches;
+        located_ranges += other.located_ranges;
+        hits += other.hits;
+        seconds += other.seconds;
+        return *this;
+    }
+};
+
+/*!
+ * \brief A stemloop compiled into contiguous arrays for the search.
+ *
+ * \details
+ * The positions of all stemloop elements are concatenated into a sequence of steps, such that the step after
+ * the last position of an element is the first position of the next element. Each step refers to a range of
+ * options, which are ordered by descending score, and to a range of gap jumps, which store absolute step indices.
+ * The step index `size()` marks the end of the stemloop. For each step the program also stores the maximum score
+ * that the remaining steps can add, which bounds the score of any hit that extends the current query.
+ */
+class SearchProgram
+{
+private:
+    //! \brief The steps, one for each position of the stemloop.
+    std::vector<SearchStep> steps;
+    //! \brief The options of all steps.
+    std::vector<SearchOption> options;
+    //! \brief The gap jump targets of all steps.
+    std::vector<uint32_t> jumps;
+    //! \brief The maximum score that can be added from each step to the end, including the end step.
+    std::vector<float> potentials;
+
+public:
+    /*!
+     * \brief Compile a stemloop into a search program.
+     * \param stemloop The stemloop to be searched.
+     */
+    explicit SearchProgram(Stemloop const & stemloop);
+
+    //! \brief The number of steps.
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(steps.size());
+    }
+
+    //! \brief Access a step.
+    SearchStep const & step(uint32_t idx) const
+    {
+        return steps[idx];
+    }
+
+    //! \brief Access an option.
+    SearchOption const & option(uint32_t idx) const
+    {
+        return options[idx];
+    }
+
+    //! \brief Access the target step of a gap jump.
+    uint32_t jump(uint32_t idx) const
+    {
+        return jumps[idx];
+    }
+
+    //! \brief The maximum score that can be added from a step to the end of the stemloop.
+    float potential(uint32_t step) const
+    {
+        return potentials[step];
+    }
+};
+
 //! \brief Provides a bi-directional step-by-step stemloop search with backtracking.
 class SearchInfo
 {
@@ -52,6 +155,15 @@ private:
     //! \brief Storage for the task futures of locating the hits.
     ConcurrentFutureVector & queries;
 
+    //! \brief The statistics of the search.
+    SearchStats stats{};
+
+    //! \brief The global number of the first sequence in the searched index segment.
+    size_t sequence_offset;
+
+    //! \brief The minimum score of a hit, below which paths are neither explored nor located.
+    float min_score;
+
 public:
     /*!
      * \brief Constructor for a bi-directional search.
@@ -59,32 +171,30 @@ public:
      * \param stemloop The stemloop to be searched.
      * \param hits Storage for the resulting stemloop hits.
      * \param queries Storage for the task futures of locating the hits.
+     * \param sequence_offset The global number of the first sequence in the index segment.
+     * \param min_score The minimum score of a hit; hits need a positive score in any case.
      */
     SearchInfo(Index const & index,
                Stemloop const & stemloop,
                StemloopHitStore & hits,
-               ConcurrentFutureVector & queries):
+               ConcurrentFutureVector & queries,
+               size_t sequence_offset = 0,
+               float min_score = 0.f):
         stemloop{stemloop},
         hits{hits},
-        queries{queries}
+        queries{queries},
+        sequence_offset{sequence_offset},
+        min_score{min_score}
     {
         history.emplace_back(0, index);
     }
 
     /*!
-     * \brief Append a character to the 5' (left) side of the query.
-     * \param item The character to be added.
-     * \param left Whether the loop is at the 5' side.
-     * \returns whether the operation was successful.
-     */
-    bool append_loop(std::pair<float, seqan3::rna4> item, bool left);
-
-    /*!
-     * \brief Append a character pair at both sides of the query.
-     * \param stem_item The score and characters to be added.
+     * \brief Append characters to the 5' and/or 3' side of the query.
+     * \param opt The score and characters to be added.
      * \returns whether the operation was successful.
      */
-    bool append_stem(ScoredRnaPair stem_item);
+    bool append(SearchOption const & opt);
 
     //! \brief Revert the previous append step, which shrinks the query by one or two characters.
     void backtrack();
@@ -96,27 +206,27 @@ public:
     [[nodiscard]] bool xdrop() const;
 
     /*!
-     * \brief Determine whether we have reached the last element of the stemloop.
-     * \return the end iterator for the stemloop's elements.
+     * \brief Whether the current query cannot be extended to a hit with the minimum score.
+     * \param potential The maximum score that the remaining steps can add.
+     * \return True if the search can be aborted, false otherwise.
      */
-    ElementIter stemloop_end() const
-    {
-        return stemloop.elements.cend();
-    }
+    [[nodiscard]] bool hopeless(float potential) const;
 
     //! \brief Locate the current query in the genome and store the result in `hits`.
-    void compute_hits() const;
-};
+    void compute_hits();
 
-/*!
- * \brief Recursive function that descends in the search tree.
- * \tparam MotifElement Type that determines whether we search a loop or stem.
- * \param info A reference to the search information.
- * \param elem_it The current stemloop element where to start the search.
- * \param idx The position in the stemloop element where to start the search.
- */
-template <typename MotifElement>
-void recurse_search(SearchInfo & info, ElementIter elem_it, Position idx);
+    /*!
+     * \brief Run the depth-first search through the search tree of the stemloop.
+     * \param program The compiled stemloop.
+     */
+    void search(SearchProgram const & program);
+
+    //! \brief The statistics of the search, where the number of hits is not available until the location is done.
+    SearchStats const & statistics() const
+    {
+        return stats;
+    }
+};
 
 /*!
  * \brief Combine hits into motif locations separately for each sequence in range.
@@ -135,7 +245,49 @@ void merge_hits(MotifLocationStore & locations,
                 size_t sidx_end);
 
 /*!
- * \brief Initiate the recursive search.
+ * \brief Search each stemloop of the motif in the index and collect the hits, without merging them.
+ * \param index The index to be searched in.
+ * \param motif The motif to be searched.
+ * \param hits The storage for the hits, which has an entry for each sequence of the index.
+ * \param db_len The total length of the database, which determines the minimum scores for the search e-value.
+ * \return The search statistics of each stemloop, including the number of hits.
+ */
+std::vector<SearchStats> search_hits(BiDirectionalIndex const & index,
+                                     Motif const & motif,
+                                     StemloopHitStore & hits,
+                                     size_t db_len);
+
+/*!
+ * \brief Merge the hits of all sequences into motif locations in parallel.
+ * \param locations The resulting locations.
+ * \param hits The hits for each sequence.
+ * \param motif The motif, i.e. the vector of stemloops that was subject to the search.
+ * \param db_len The total length of all sequences, which determines the e-values.
+ * \param seqnum The number of sequences.
+ */
+void merge_all_hits(MotifLocationStore & locations, StemloopHitStore & hits, Motif const & motif, size_t db_len,
+                    size_t seqnum);
+
+/*!
+ * \brief Search the motif in the index and collect the resulting locations.
+ * \param index The index to be searched in.
+ * \param motif The motif to be searched.
+ * \param locations The storage for the resulting locations (unsorted).
+ * \return The search statistics of each stemloop.
+ */
+std::vector<SearchStats> search_motif(BiDirectionalIndex const & index,
+                                      Motif const & motif,
+                                      MotifLocationStore & locations);
+
+/*!
+ * \brief Write the search statistics in JSON format to the stats file, if one is given in the settings.
+ * \param motif The motif that was searched.
+ * \param stats The search statistics of each stemloop.
+ */
+void store_search_stats(Motif const & motif, std::vector<SearchStats> const & stats);
+
+/*!
+ * \brief Search the motif in the index and print the resulting locations.
  * \param index The index to be searched in.
  * \param motif The motif to be searched.
  */
@@ -0,0 +1,437 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#ifdef SEQAN3_HAS_ZLIB
+    #include <zlib.h>
+#endif
+
+#include <seqan3/io/exception.hpp>
+
+#include "parallel_for.hpp"
+#include "sequence_reader.hpp"
+#include "settings.hpp"
+
+namespace mars
+{
+
+//! \brief The number of characters that are converted by a single task.
+static constexpr size_t piece_size{1ul << 22};
+
+//! \brief Marks whitespace and digits in the rank table, which are skipped in sequences.
+static constexpr int8_t skipped_char{-1};
+
+//! \brief Marks characters in the rank table that are not nucleotides, which are rejected.
+static constexpr int8_t invalid_char{-2};
+
+//! \brief The dna4 rank of each nucleotide character, including U and the IUPAC codes, which seqan3 accepts.
+static std::array<int8_t, 256> const rank_table = [] ()
+{
+    std::string_view const nucleotides{"ACGTUNRYSWKMBDHV"};
+    std::array<int8_t, 256> table{};
+    for (int chr = 0; chr < 256; ++chr)
+    {
+        if (chr != 0 && nucleotides.find(static_cast<char>(std::toupper(chr))) != std::string_view::npos)
+            table[chr] = static_cast<int8_t>(seqan3::dna4{}.assign_char(chr).to_rank());
+        else if (std::isspace(chr) || std::isdigit(chr))
+            table[chr] = skipped_char;
+        else
+            table[chr] = invalid_char;
+    }
+    return table;
+}();
+
+/*!
+ * \brief A part of a sequence that is converted by a single task.
+ * \details The pieces of a sequence are consecutive, such that their output offsets are the prefix sums.
+ */
+struct Piece
+{
+    size_t record; //!< The sequence number.
+    size_t begin; //!< The start position in the input.
+    size_t end; //!< One after the end position in the input.
+    size_t offset; //!< The start position in the packed text.
+    size_t length; //!< The number of output characters.
+};
+
+//! \brief Read a whole file into memory.
+static std::string read_file(std::filesystem::path const & filepath)
+{
+    std::ifstream ifs{filepath, std::ios::binary};
+    if (!ifs)
+        throw seqan3::file_open_error{"Could not open the sequence file <== " + filepath.string()};
+    std::string content(std::filesystem::file_size(filepath), '\0');
+    ifs.read(content.data(), content.size());
+    content.resize(ifs.gcount());
+    return content;
+}
+
+#ifdef SEQAN3_HAS_ZLIB
+/*!
+ * \brief Inflate the blocks of a BGZF file in parallel.
+ * \param[in] packed The file content.
+ * \param[out] text The inflated content.
+ * \return whether the file consists of BGZF blocks; otherwise the text is not modified.
+ */
+static bool inflate_bgzf(std::string const & packed, std::string & text)
+{
+    struct Block
+    {
+        size_t data; // the start of the deflate stream
+        size_t data_size;
+        size_t offset; // the start position in the text
+        size_t size;
+    };
+    std::vector<Block> blocks{};
+    size_t total{0};
+    auto byte = [&packed] (size_t pos) { return static_cast<uint8_t>(packed[pos]); };
+    for (size_t pos = 0; pos < packed.size();)
+    {
+        // A BGZF block is a gzip member with the extra subfield BC, which contains the block size.
+        if (pos + 18 > packed.size() || byte(pos) != 0x1f || byte(pos + 1) != 0x8b || (byte(pos + 3) & 4) == 0)
+            return false;
+        size_t const xlen = byte(pos + 10) | (byte(pos + 11) << 8);
+        size_t block_size{0};
+        for (size_t sub = pos + 12; sub + 4 <= pos + 12 + xlen && sub + 4 <= packed.size();)
+        {
+            size_t const slen = byte(sub + 2) | (byte(sub + 3) << 8);
+            if (packed[sub] == 'B' && packed[sub + 1] == 'C' && slen == 2 && sub + 6 <= packed.size())
+                block_size = (byte(sub + 4) | (byte(sub + 5) << 8)) + 1;
+            sub += 4 + slen;
+        }
+        if (block_size < 12 + xlen + 8 || pos + block_size > packed.size())
+            return false;
+
+        size_t const end = pos + block_size;
+        size_t const size = byte(end - 4) | (byte(end - 3) << 8) | (byte(end - 2) << 16) |
+                            (static_cast<size_t>(byte(end - 1)) << 24);
+        blocks.push_back({pos + 12 + xlen, block_size - 12 - xlen - 8, total, size});
+        total += size;
+        pos = end;
+    }
+
+    text.assign(total, '\0');
+    parallel_for(blocks.size(), [&packed, &text, &blocks] (size_t idx)
+    {
+        Block const & block = blocks[idx];
+        if (block.size == 0)
+            return;
+        z_stream stream{};
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            throw seqan3::parse_error{"Could not initialize zlib."};
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(packed.data() + block.data));
+        stream.avail_in = static_cast<uInt>(block.data_size);
+        stream.next_out = reinterpret_cast<Bytef *>(text.data() + block.offset);
+        stream.avail_out = static_cast<uInt>(block.size);
+        int const status = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        if (status != Z_STREAM_END || stream.avail_out != 0)
+            throw seqan3::parse_error{"Corrupt BGZF block in the sequence file."};
+    });
+    return true;
+}
+
+/*!
+ * \brief Inflate a gzip file, which may consist of several members, on a single thread.
+ * \param packed The file content.
+ * \return the inflated content.
+ */
+static std::string inflate_gzip(std::string const & packed)
+{
+    std::string text{};
+    text.resize(std::max<size_t>(packed.size() * 3, 1ul << 16));
+    z_stream stream{};
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK)
+        throw seqan3::parse_error{"Could not initialize zlib."};
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(packed.data()));
+    stream.avail_in = static_cast<uInt>(std::min<size_t>(packed.size(), UINT32_MAX));
+    size_t consumed{0};
+    size_t produced{0};
+    while (true)
+    {
+        if (produced == text.size())
+            text.resize(text.size() * 2);
+        stream.next_out = reinterpret_cast<Bytef *>(text.data() + produced);
+        stream.avail_out = static_cast<uInt>(std::min<size_t>(text.size() - produced, UINT32_MAX));
+        size_t const avail_in = stream.avail_in;
+        size_t const avail_out = stream.avail_out;
+        int const status = inflate(&stream, Z_NO_FLUSH);
+        consumed += avail_in - stream.avail_in;
+        produced += avail_out - stream.avail_out;
+        if (status == Z_STREAM_END && consumed < packed.size())
+        {
+            inflateReset(&stream); // the next gzip member follows
+        }
+        else if (status == Z_STREAM_END)
+        {
+            break;
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR)
+        {
+            inflateEnd(&stream);
+            throw seqan3::parse_error{"Corrupt gzip data in the sequence file."};
+        }
+        else if (stream.avail_in == 0 && consumed == packed.size() && produced < text.size())
+        {
+            inflateEnd(&stream);
+            throw seqan3::parse_error{"Unexpected end of the gzip data in the sequence file."};
+        }
+        if (stream.avail_in == 0 && consumed < packed.size())
+        {
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(packed.data() + consumed));
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(packed.size() - consumed, UINT32_MAX));
+        }
+    }
+    inflateEnd(&stream);
+    text.resize(produced);
+    return text;
+}
+#endif
+
+/*!
+ * \brief Allocate the sequences for the pieces and compute the output offsets.
+ * \param pieces The pieces with their lengths, ordered by record.
+ * \param text The packed text, where the new records are appended.
+ * \param records The number of new records.
+ */
+static void allocate_sequences(std::vector<Piece> & pieces, PackedText & text, size_t records)
+{
+    size_t const first = text.sequence_count();
+    std::vector<size_t> lengths(records, 0ul);
+    for (Piece & piece : pieces)
+    {
+        piece.offset = lengths[piece.record - first];
+        lengths[piece.record - first] += piece.length;
+    }
+    for (size_t length : lengths)
+        text.add_sequence(length);
+    for (Piece & piece : pieces)
+        piece.offset += text.sequence_begin(piece.record);
+}
+
+/*!
+ * \brief Check whether an output position is in a word that another piece may write concurrently.
+ * \param piece The piece that is converted.
+ * \param pos The position in the packed text.
+ * \return true for the first and the last word of the piece.
+ */
+static bool is_shared(Piece const & piece, size_t pos)
+{
+    return pos / 32 == piece.offset / 32 || pos / 32 == (piece.offset + piece.length - 1) / 32;
+}
+
+/*!
+ * \brief Parse FASTA records from a string in parallel.
+ * \param fasta The content of the FASTA file, which starts with '>'.
+ * \param text The sequences are appended here.
+ * \param names The names are appended here.
+ */
+static void parse_fasta(std::string const & fasta, PackedText & text, std::vector<std::string> & names)
+{
+    // Find the record headers, which start with '>' at the beginning of a line.
+    size_t const chunk = std::max(piece_size, fasta.size() / (4 * settings.nthreads) + 1);
+    size_t const chunk_count = (fasta.size() + chunk - 1) / chunk;
+    std::vector<std::vector<size_t>> chunk_headers(chunk_count);
+    parallel_for(chunk_count, [&fasta, &chunk_headers, chunk] (size_t idx)
+    {
+        size_t const end = std::min(fasta.size(), (idx + 1) * chunk);
+        char const * ptr = fasta.data() + idx * chunk;
+        while ((ptr = static_cast<char const *>(std::memchr(ptr, '>', fasta.data() + end - ptr))) != nullptr)
+        {
+            size_t const pos = ptr - fasta.data();
+            if (pos == 0 || fasta[pos - 1] == '\n' || fasta[pos - 1] == '\r')
+                chunk_headers[idx].push_back(pos);
+            ++ptr;
+        }
+    });
+    std::vector<size_t> headers{};
+    for (auto const & positions : chunk_headers)
+        headers.insert(headers.end(), positions.cbegin(), positions.cend());
+    headers.push_back(fasta.size());
+
+    // Extract the names and split the sequences into pieces.
+    size_t const first = text.sequence_count();
+    size_t const records = headers.size() - 1;
+    std::vector<Piece> pieces{};
+    for (size_t rec = 0; rec < records; ++rec)
+    {
+        size_t const line_end = std::min(fasta.find('\n', headers[rec]), headers[rec + 1]);
+        size_t name_end = headers[rec] + 1;
+        while (name_end < line_end && !std::isspace(static_cast<unsigned char>(fasta[name_end])))
+            ++name_end;
+        names.emplace_back(fasta, headers[rec] + 1, name_end - headers[rec] - 1);
+        for (size_t pos = std::min(line_end + 1, headers[rec + 1]); pos < headers[rec + 1]; pos += piece_size)
+            pieces.push_back({first + rec, pos, std::min(pos + piece_size, headers[rec + 1]), 0ul, 0ul});
+    }
+
+    // Count the nucleotides of each piece, then convert them directly into the allocated sequences.
+    parallel_for(pieces.size(), [&fasta, &pieces] (size_t idx)
+    {
+        Piece & piece = pieces[idx];
+        for (size_t pos = piece.begin; pos < piece.end; ++pos)
+        {
+            int8_t const rank = rank_table[static_cast<uint8_t>(fasta[pos])];
+            if (rank == invalid_char)
+            {
+                throw seqan3::parse_error{std::string{"Encountered an unexpected character '"} + fasta[pos] +
+                                          "' in the sequence file."};
+            }
+            piece.length += rank >= 0;
+        }
+    });
+    allocate_sequences(pieces, text, records);
+    parallel_for(pieces.size(), [&fasta, &pieces, &text] (size_t idx)
+    {
+        Piece const & piece = pieces[idx];
+        size_t out = piece.offset;
+        for (size_t pos = piece.begin; pos < piece.end; ++pos)
+        {
+            int8_t const rank = rank_table[static_cast<uint8_t>(fasta[pos])];
+            if (rank >= 0)
+            {
+                text.set(out, seqan3::dna4{}.assign_rank(rank), is_shared(piece, out));
+                ++out;
+            }
+        }
+    });
+}
+
+/*!
+ * \brief Parse the sequences of a UCSC 2bit file in parallel.
+ * \param data The content of the 2bit file.
+ * \param text The sequences are appended here.
+ * \param names The names are appended here.
+ * \throws seqan3::parse_error if the file is corrupt.
+ */
+static void parse_twobit(std::string const & data, PackedText & text, std::vector<std::string> & names)
+{
+    // The byte order is given by the signature, and version 1 uses 64-bit sequence offsets.
+    bool const swap = static_cast<uint8_t>(data[0]) == 0x1A;
+    auto read32 = [&data, swap] (size_t pos)
+    {
+        if (pos + 4 > data.size())
+            throw seqan3::parse_error{"Unexpected end of the 2bit file."};
+        uint32_t value{};
+        std::memcpy(&value, data.data() + pos, 4);
+        return swap ? __builtin_bswap32(value) : value;
+    };
+    uint32_t const version = read32(4);
+    uint32_t const count = read32(8);
+
+    struct Record
+    {
+        size_t dna; // the start of the packed sequence
+        size_t size;
+        std::vector<std::pair<size_t, size_t>> n_blocks;
+    };
+    std::vector<Record> record_info(count);
+    size_t pos{16};
+    for (Record & record : record_info)
+    {
+        size_t const name_size = static_cast<uint8_t>(data.at(pos));
+        names.emplace_back(data.substr(pos + 1, name_size));
+        pos += 1 + name_size;
+        size_t offset = read32(pos);
+        pos += 4;
+        if (version == 1)
+        {
+            offset |= static_cast<size_t>(read32(pos)) << 32;
+            pos += 4;
+        }
+
+        record.size = read32(offset);
+        size_t const n_count = read32(offset + 4);
+        for (size_t idx = 0; idx < n_count; ++idx)
+            record.n_blocks.emplace_back(read32(offset + 8 + 4 * idx), read32(offset + 8 + 4 * (n_count + idx)));
+        std::sort(record.n_blocks.begin(), record.n_blocks.end());
+        size_t const mask_pos = offset + 8 + 8 * n_count;
+        size_t const mask_count = read32(mask_pos);
+        record.dna = mask_pos + 4 + 8 * mask_count + 4;
+        if (record.dna + (record.size + 3) / 4 > data.size())
+            throw seqan3::parse_error{"Unexpected end of the 2bit file."};
+    }
+
+    // Split the sequences into pieces, whose start is aligned to full bytes.
+    size_t const first = text.sequence_count();
+    std::vector<Piece> pieces{};
+    for (size_t rec = 0; rec < count; ++rec)
+        for (size_t begin = 0; begin < record_info[rec].size; begin += piece_size)
+        {
+            size_t const end = std::min(begin + piece_size, record_info[rec].size);
+            pieces.push_back({first + rec, begin, end, 0ul, end - begin});
+        }
+    allocate_sequences(pieces, text, count);
+
+    // The 2bit codes are T, C, A, G, and N blocks are converted like dna4 converts N.
+    std::array<uint8_t, 4> const code_rank{3, 1, 0, 2};
+    seqan3::dna4 const n_chr = seqan3::dna4{}.assign_rank(rank_table['N']);
+    parallel_for(pieces.size(), [&data, &pieces, &text, &record_info, &code_rank, first, n_chr] (size_t idx)
+    {
+        Piece const & piece = pieces[idx];
+        Record const & record = record_info[piece.record - first];
+        auto n_block = std::partition_point(record.n_blocks.cbegin(), record.n_blocks.cend(),
+                                            [&piece] (auto const & block)
+        {
+            return block.first + block.second <= piece.begin;
+        });
+        size_t out = piece.offset;
+        for (size_t pos = piece.begin; pos < piece.end; ++pos, ++out)
+        {
+            while (n_block != record.n_blocks.cend() && n_block->first + n_block->second <= pos)
+                ++n_block;
+            uint8_t const byte = static_cast<uint8_t>(data[record.dna + pos / 4]);
+            seqan3::dna4 chr = seqan3::dna4{}.assign_rank(code_rank[(byte >> (6 - 2 * (pos % 4))) & 3]);
+            if (n_block != record.n_blocks.cend() && n_block->first <= pos)
+                chr = n_chr;
+            text.set(out, chr, is_shared(piece, out));
+        }
+    });
+}
+
+bool read_sequences_parallel(std::filesystem::path const & filepath,
+                             PackedText & text,
+                             std::vector<std::string> & names)
+{
+    if (!std::filesystem::is_regular_file(filepath))
+        return false;
+
+    std::string data = read_file(filepath);
+    bool const twobit = data.compare(0, 4, "\x43\x27\x41\x1A") == 0 || data.compare(0, 4, "\x1A\x41\x27\x43") == 0;
+    if (data.size() >= 16 && twobit)
+    {
+        parse_twobit(data, text, names);
+        return true;
+    }
+
+    if (data.size() >= 2 && static_cast<uint8_t>(data[0]) == 0x1f && static_cast<uint8_t>(data[1]) == 0x8b)
+    {
+#ifdef SEQAN3_HAS_ZLIB
+        std::string inflated{};
+        if (!inflate_bgzf(data, inflated))
+            inflated = inflate_gzip(data);
+        data = std::move(inflated);
+#else
+        return false;
+#endif
+    }
+
+    // Other formats than FASTA are parsed by the caller.
+    size_t const start = data.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos || data[start] != '>')
+        return false;
+    data.erase(0, start);
+    parse_fasta(data, text, names);
+    return true;
+}
+
+} // namespace mars
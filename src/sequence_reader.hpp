@@ -0,0 +1,39 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <seqan3/std/filesystem>
+#include <string>
+#include <vector>
+
+#include "packed_text.hpp"
+
+namespace mars
+{
+
+/*!
+ * \brief Read a genome in parallel on the thread pool, if it is stored in a supported format.
+ * \param[in] filepath The sequence file.
+ * \param[out] text The sequences are appended here.
+ * \param[out] names The sequence names, truncated at the first whitespace, are appended here.
+ * \return whether the format is supported; otherwise nothing is appended and the caller must parse the file.
+ * \throws seqan3::parse_error if a supported file is corrupt or contains characters that are not nucleotides.
+ *
+ * \details
+ * Supported are FASTA files, either plain, gzip-compressed or BGZF-compressed, and UCSC 2bit files. The format is
+ * detected by the content and not by the file extension. The blocks of BGZF files are inflated in parallel,
+ * whereas plain gzip files need a single thread for inflating. The file is split into chunks that are scanned
+ * and converted concurrently into the packed text, also within long sequences. The characters are checked and
+ * converted like the seqan3 FASTA reader does for `seqan3::dna4`: whitespace and digits are skipped, IUPAC codes
+ * are accepted and converted, e.g. N becomes A, and other characters are rejected.
+ */
+bool read_sequences_parallel(std::filesystem::path const & filepath,
+                             PackedText & text,
+                             std::vector<std::string> & names);
+
+} // namespace mars
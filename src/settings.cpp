@@ -5,9 +5,16 @@
 // shipped with this file and also available at https://github.com/seqan/mars.
 // ------------------------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <seqan3/argument_parser/all.hpp>
 
+#include "numa.hpp"
+#include "phase_report.hpp"
 #include "settings.hpp"
+#include "thread_budget.hpp"
+#include "trace.hpp"
 
 namespace mars
 {
@@ -15,6 +22,7 @@ namespace mars
 std::unique_ptr<thread_pool::ThreadPool> pool;
 std::mutex mutex_console;
 Settings settings{};
+ThreadBudget thread_budget{};
 
 bool Settings::parse_arguments(int argc, char ** argv)
 {
@@ -71,6 +79,15 @@ bool Settings::parse_arguments(int argc, char ** argv)
     parser.add_option(genome_file, 'g', "genome",
                       "A sequence file containing one or more sequences.");
 
+    parser.add_option(update_file, 'u', "update",
+                      "A sequence file whose sequences are added to the index of the genome as a new segment, "
+                      "without rebuilding the existing index. Small segments are merged in the background.");
+
+    parser.add_option(index_cache, 'c', "cache",
+                      "A directory where indices are stored and looked up by the content hash of the sequences, "
+                      "instead of next to the genome file. Identical genomes at different paths share an index, "
+                      "and a modified genome gets a new index.");
+
 #if SEQAN3_WITH_CEREAL
     parser.add_option(alignment_file, 'a', "alignment",
                       "Alignment file of structurally aligned RNA sequences, "
@@ -87,7 +104,9 @@ bool Settings::parse_arguments(int argc, char ** argv)
     //output path as option, otherwise output is printed
     parser.add_subsection("Output options:");
     parser.add_option(result_file, 'o', "output",
-                      "The output file for the results. If empty we print to stdout.");
+                      "The output file for the results. The format is chosen by the file extension: BED (.bed), "
+                      "GFF3 (.gff, .gff3), JSON lines (.jsonl) or otherwise the MaRs table. If empty we print the "
+                      "table to stdout.");
 
 #if SEQAN3_WITH_CEREAL
     parser.add_option(motif_file, 'm', "motif", "File for storing the motifs.", seqan3::option_spec::standard,
@@ -98,6 +117,27 @@ bool Settings::parse_arguments(int argc, char ** argv)
                       seqan3::option_spec::standard,
                       seqan3::output_file_validator{seqan3::output_file_open_options::open_or_create, {"pat"}});
 
+    parser.add_option(stats_file, 't', "stats",
+                      "Output file for the search statistics of each stemloop in JSON format.",
+                      seqan3::option_spec::standard,
+                      seqan3::output_file_validator{seqan3::output_file_open_options::open_or_create, {"json"}});
+
+    parser.add_option(report_file, 'R', "report",
+                      "Output file for the wall time, CPU time and peak memory of each phase in JSON format. "
+                      "The report is also printed with verbosity level 2.",
+                      seqan3::option_spec::standard,
+                      seqan3::output_file_validator{seqan3::output_file_open_options::open_or_create, {"json"}});
+
+    parser.add_option(trace_file, 'T', "trace",
+                      "Output file for a timeline of the tasks and phases of each thread in the Chrome trace event "
+                      "format, which can be viewed with chrome://tracing or ui.perfetto.dev.",
+                      seqan3::option_spec::standard,
+                      seqan3::output_file_validator{seqan3::output_file_open_options::open_or_create, {"json"}});
+
+    parser.add_flag(perf_counters, 'P', "perf",
+                    "Add the hardware performance counters (cycles, instructions, last level cache misses and branch "
+                    "misses) of each phase and of the search and locate tasks to the phase report.");
+
     parser.add_option(score_filter, 's', "scorefilter",
                       "Minimum score per motif that a hit must achieve. If it is 'nan', we use e-values for filtering "
                       "hits instead.");
@@ -114,17 +154,65 @@ bool Settings::parse_arguments(int argc, char ** argv)
     parser.add_option(xdrop, 'x', "xdrop",
                       "The xdrop parameter. Smaller values increase speed but we will find less matches.");
 
+    parser.add_option(search_evalue, 'E', "search-evalue",
+                      "Calibrate the score distribution of each stemloop on random background sequence and skip the "
+                      "stemloop hits that are expected to occur more often than this number by chance in the genome. "
+                      "Smaller values increase speed but we will find less matches. If it is 'nan', all hits with a "
+                      "positive score are located.");
+
     parser.add_flag(limit, 'l', "limit",
                     "Limit motif to stemloops, do not consider long exterior and multibranch loops.");
 
+    parser.add_option(fold_method, 'f', "fold",
+                      "The method for predicting the consensus structure of a Clustal alignment: integer programming "
+                      "with pseudoknots (ipknot), or the faster maximum expected accuracy folding without pseudoknots "
+                      "(mea) or with a greedy pseudoknot layer (mea-pk).",
+                      seqan3::option_spec::standard,
+                      seqan3::value_list_validator{"ipknot", "mea", "mea-pk"});
+
+    parser.add_option(fold_engine, 'e', "fold-engine",
+                      "The engine for computing base pair probabilities of a Clustal alignment: fold each sequence "
+                      "with CONTRAfold and average the probabilities (contrafold), or fold the alignment once with "
+                      "covariation-aware energies (alifold), which is much faster for deep alignments.",
+                      seqan3::option_spec::standard,
+                      seqan3::value_list_validator{"contrafold", "alifold"});
+
+    parser.add_option(fold_depth, 'd', "fold-depth",
+                      "The maximum number of alignment rows that are used for predicting the consensus structure. "
+                      "For deeper alignments we select a diverse subset of the sequences, while the motif is still "
+                      "built from all rows. Zero means that all rows are used.");
+
 #ifdef SEQAN3_HAS_ZLIB
     parser.add_flag(compress_index, 'z', "gzip",
-                    "Use gzip compression for the index file.");
+                    "Compress the index file with zlib in independent blocks, which are compressed and decompressed "
+                    "in parallel.");
 #endif
 
     parser.add_option(nthreads, 'j', "threads",
                       "Use the number of specified threads.");
 
+    parser.add_option(numa, 'N', "numa",
+                      "The placement of the index on multi-socket machines: keep it where it was built (off), "
+                      "replicate it on each NUMA node and search with the local replica (replicate), or spread its "
+                      "pages over all nodes (interleave). The threads are pinned to the nodes unless it is off.",
+                      seqan3::option_spec::standard,
+                      seqan3::value_list_validator{"off", "replicate", "interleave"});
+
+    parser.add_option(workers, 'W', "workers",
+                      "Search the existing index in the specified number of local worker processes, each of which "
+                      "loads an even share of the index segments. This process merges their hits and prints the "
+                      "results. A new index is built with a segment for each worker. Zero means that the index is "
+                      "searched in this process.");
+
+    std::string shard{};
+    parser.add_option(shard, '\0', "shard",
+                      "Internal: search the index shard <number>/<count> as a worker process.",
+                      seqan3::option_spec::hidden);
+
+    parser.add_option(shard_motif, '\0', "shard-motif",
+                      "Internal: the motif file of a worker process.",
+                      seqan3::option_spec::hidden);
+
     try
     {
         parser.parse();                                                  // trigger command line parsing
@@ -135,7 +223,43 @@ bool Settings::parse_arguments(int argc, char ** argv)
         return false;
     }
 
+    if (!shard.empty())
+    {
+        // A worker shares the machine with the other workers and reports errors only.
+        size_t const slash = shard.find('/');
+        try
+        {
+            shard_index = std::stoul(shard.substr(0, slash));
+            shard_count = slash == std::string::npos ? 1 : std::stoul(shard.substr(slash + 1));
+        }
+        catch (std::logic_error const &)
+        {
+            shard_count = 0;
+        }
+        if (shard_count == 0 || shard_index >= shard_count)
+        {
+            seqan3::debug_stream << "Parsing error. Invalid shard " << shard << "\n";
+            return false;
+        }
+        nthreads = std::max(1u, nthreads / static_cast<unsigned int>(shard_count));
+        verbose = verbose > 1 ? verbose : 0;
+        workers = 0;
+    }
+    else if (workers > 0 && !index_cache.empty())
+    {
+        logger(1, "Worker processes cannot use the index cache, searching in a single process." << std::endl);
+        workers = 0;
+    }
+
+    if (!trace_file.empty())
+        tracer.enable();
+    // The counters must be opened before the threads are created, such that they are inherited.
+    if (perf_counters && !phase_report.enable_counters())
+        logger(1, "Hardware performance counters are not available on this system." << std::endl);
     pool = std::make_unique<thread_pool::ThreadPool>(nthreads);
+    thread_budget.reset(nthreads);
+    if (numa != "off")
+        Numa::pin_pool_workers();
     return true;
 }
 
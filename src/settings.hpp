@@ -10,6 +10,7 @@
 #include <cmath>
 #include <seqan3/std/filesystem>
 #include <memory>
+#include <string>
 
 #include <seqan3/core/debug_stream.hpp>
 
@@ -33,18 +34,34 @@ struct Settings
     // input
     std::filesystem::path genome_file{}; //!< The filename for reading the genome.
     std::filesystem::path alignment_file{}; //!< The filename for reading the alignment.
+    std::filesystem::path update_file{}; //!< The filename of sequences that are added to the index as a segment.
+    std::filesystem::path index_cache{}; //!< The directory where indices are stored under their content hash.
     // output
     std::filesystem::path result_file{}; //!< The filename for writing the results (locations).
     std::filesystem::path motif_file{}; //!< The filename for writing the motifs.
     std::filesystem::path structator_file{}; //!< The filename for writing the Structator RSSPs.
+    std::filesystem::path stats_file{}; //!< The filename for writing the search statistics.
+    std::filesystem::path report_file{}; //!< The filename for writing the phase report.
+    std::filesystem::path trace_file{}; //!< The filename for writing the task timeline.
     float score_filter{NAN}; //!< The minimum score per stemloop for the output, NAN = evalue criterion.
     unsigned short verbose{1}; //!< The verbosity level of the output.
     // performance
     unsigned char prune{10}; //!< Parameter for reducing the motif.
     unsigned char xdrop{4};  //!< Parameter for pruning the search.
+    float search_evalue{NAN}; //!< The tolerated number of chance hits per stemloop, NAN = no calibration.
     bool limit{false}; //!< Flag whether exterior loops are considered.
     bool compress_index{false}; //!< Flag whether the index should be compressed.
+    bool perf_counters{false}; //!< Flag whether hardware performance counters are added to the phase report.
+    std::string fold_method{"ipknot"}; //!< The method for predicting the consensus structure of an alignment.
+    std::string fold_engine{"contrafold"}; //!< The engine for computing base pair probabilities of an alignment.
+    size_t fold_depth{0}; //!< The maximum number of alignment rows used for structure prediction, 0 = all.
+    std::string numa{"off"}; //!< The placement of the index on NUMA nodes: off, replicate or interleave.
     unsigned int nthreads{std::thread::hardware_concurrency()};  //!< The number of threads in the pool.
+    // processes
+    unsigned int workers{0}; //!< The number of worker processes that search the index shards, 0 = no workers.
+    size_t shard_index{0}; //!< The index shard that this worker process searches.
+    size_t shard_count{0}; //!< The number of index shards if this is a worker process, 0 otherwise.
+    std::filesystem::path shard_motif{}; //!< The motif file that the coordinator has passed to this worker.
 
     /*!
      * \brief Run the argument parser.
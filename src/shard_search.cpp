@@ -0,0 +1,463 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <seqan3/io/exception.hpp>
+
+#include "index.hpp"
+#include "phase_report.hpp"
+#include "settings.hpp"
+#include "shard_search.hpp"
+
+extern char ** environ;
+
+namespace mars
+{
+
+//! \brief The magic string at the start of a hit stream.
+static constexpr std::string_view hit_stream_magic{"MARSHIT1"};
+
+//! \brief Append a number as a variable-length integer with 7 bits per byte.
+static void put_varint(std::string & out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+//! \brief Append the binary representation of a number.
+template <typename number_t>
+static void put_raw(std::string & out, number_t value)
+{
+    out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+//! \brief Reads the numbers of a hit stream in order.
+class HitStreamReader
+{
+private:
+    std::string const & stream; //!< The binary stream.
+    size_t pos; //!< The current read position.
+
+public:
+    /*!
+     * \brief Start reading after the magic string.
+     * \param stream The binary stream.
+     */
+    explicit HitStreamReader(std::string const & stream) : stream{stream}, pos{hit_stream_magic.size()}
+    {
+        if (stream.compare(0, hit_stream_magic.size(), hit_stream_magic) != 0)
+            throw seqan3::parse_error{"The hit stream of a worker process is corrupt."};
+    }
+
+    //! \brief Read a variable-length integer.
+    uint64_t varint()
+    {
+        uint64_t value{0};
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= stream.size())
+                throw seqan3::parse_error{"The hit stream of a worker process is truncated."};
+            uint8_t const byte = static_cast<uint8_t>(stream[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80)
+                return value;
+        }
+        throw seqan3::parse_error{"The hit stream of a worker process is corrupt."};
+    }
+
+    //! \brief Read the binary representation of a number.
+    template <typename number_t>
+    number_t raw()
+    {
+        number_t value{};
+        if (pos + sizeof(value) > stream.size())
+            throw seqan3::parse_error{"The hit stream of a worker process is truncated."};
+        std::memcpy(&value, stream.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+
+    //! \brief Read a string that is preceded by its length.
+    std::string string()
+    {
+        size_t const len = varint();
+        if (pos + len > stream.size())
+            throw seqan3::parse_error{"The hit stream of a worker process is truncated."};
+        pos += len;
+        return stream.substr(pos - len, len);
+    }
+};
+
+std::string encode_shard_result(ShardResult & result)
+{
+    std::string out{hit_stream_magic};
+    put_varint(out, result.text_length);
+    put_varint(out, result.names.size());
+    for (std::string const & name : result.names)
+    {
+        put_varint(out, name.size());
+        out.append(name);
+    }
+    put_varint(out, result.stats.size());
+    for (SearchStats const & stat : result.stats)
+    {
+        for (size_t value : {stat.nodes, stat.extensions, stat.failed_extensions, stat.xdrop_prunes,
+                             stat.score_prunes, stat.gap_branches, stat.located_ranges, stat.hits})
+            put_varint(out, value);
+        put_raw<double>(out, stat.seconds);
+    }
+    // The positions are stored as zigzag-encoded differences to the previous hit of the sequence.
+    for (std::vector<StemloopHit> & hitvec : result.hits)
+    {
+        std::sort(hitvec.begin(), hitvec.end());
+        put_varint(out, hitvec.size());
+        long long previous{0};
+        for (StemloopHit const & hit : hitvec)
+        {
+            long long const diff = hit.pos - previous;
+            put_varint(out, (static_cast<uint64_t>(diff) << 1) ^ static_cast<uint64_t>(diff >> 63));
+            put_varint(out, static_cast<uint64_t>(hit.length));
+            out.push_back(static_cast<char>(hit.midx));
+            put_raw<float>(out, hit.score);
+            previous = hit.pos;
+        }
+    }
+    return out;
+}
+
+ShardResult decode_shard_result(std::string const & stream)
+{
+    HitStreamReader reader{stream};
+    ShardResult result{};
+    result.text_length = reader.varint();
+    result.names.resize(reader.varint());
+    for (std::string & name : result.names)
+        name = reader.string();
+    result.stats.resize(reader.varint());
+    for (SearchStats & stat : result.stats)
+    {
+        for (size_t * value : {&stat.nodes, &stat.extensions, &stat.failed_extensions, &stat.xdrop_prunes,
+                               &stat.score_prunes, &stat.gap_branches, &stat.located_ranges, &stat.hits})
+            *value = reader.varint();
+        stat.seconds = reader.raw<double>();
+    }
+    result.hits.resize(result.names.size());
+    for (std::vector<StemloopHit> & hitvec : result.hits)
+    {
+        hitvec.resize(reader.varint());
+        long long previous{0};
+        for (StemloopHit & hit : hitvec)
+        {
+            uint64_t const zigzag = reader.varint();
+            hit.pos = previous + static_cast<long long>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+            hit.length = static_cast<long long>(reader.varint());
+            hit.midx = reader.raw<uint8_t>();
+            hit.score = reader.raw<float>();
+            previous = hit.pos;
+        }
+    }
+    return result;
+}
+
+void search_shard()
+{
+    ShardResult result{};
+    Motif const motif = restore_motif(settings.shard_motif);
+    BiDirectionalIndex index{};
+    index.create_shard(settings.shard_index, settings.shard_count);
+    result.names = index.get_names();
+    result.text_length = index.text_length();
+
+    // Exchange the text length for the total length of all shards, which determines the minimum scores.
+    uint64_t db_len = result.text_length;
+    std::cout.write(reinterpret_cast<char const *>(&db_len), sizeof(db_len));
+    std::cout.flush();
+    if (!std::cin.read(reinterpret_cast<char *>(&db_len), sizeof(db_len)))
+        throw std::runtime_error{"Could not receive the database length from the coordinator."};
+
+    if (!motif.empty() && !index.empty())
+    {
+        StemloopHitStore hits(result.names.size());
+        result.stats = search_hits(index, motif, hits, db_len);
+        result.hits.resize(result.names.size());
+        for (size_t seq = 0; seq < result.hits.size(); ++seq)
+            result.hits[seq].swap(hits.get(seq));
+    }
+    else
+    {
+        result.stats.resize(motif.size());
+        result.hits.resize(result.names.size());
+    }
+
+    std::string const stream = encode_shard_result(result);
+    std::cout.write(stream.data(), stream.size());
+    std::cout.flush();
+}
+
+//! \brief A worker process with the pipes of its hit stream and of the database length.
+struct WorkerProcess
+{
+    pid_t pid{-1}; //!< The process id.
+    int pipe_fd{-1}; //!< The read end of the pipe that is connected to the standard output of the worker.
+    int input_fd{-1}; //!< The write end of the pipe that is connected to the standard input of the worker.
+};
+
+/*!
+ * \brief Start a worker process for a shard.
+ * \param args The arguments of the worker, starting with the program name.
+ * \return the process and its pipe.
+ * \throws std::runtime_error if the process cannot be started.
+ */
+static WorkerProcess spawn_worker(std::vector<std::string> const & args)
+{
+    std::vector<char *> arg_ptrs{};
+    for (std::string const & arg : args)
+        arg_ptrs.push_back(const_cast<char *>(arg.c_str()));
+    arg_ptrs.push_back(nullptr);
+
+    // All pipe ends are closed on exec, except for the copies that become the standard output and input of the worker.
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+        throw std::runtime_error{std::string{"Could not create a pipe: "} + std::strerror(errno)};
+    int in_fds[2];
+    if (pipe2(in_fds, O_CLOEXEC) != 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        throw std::runtime_error{std::string{"Could not create a pipe: "} + std::strerror(errno)};
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, in_fds[0], STDIN_FILENO);
+
+    WorkerProcess worker{};
+    int status{};
+    if (access("/proc/self/exe", X_OK) == 0)
+        status = posix_spawn(&worker.pid, "/proc/self/exe", &actions, nullptr, arg_ptrs.data(), environ);
+    else
+        status = posix_spawnp(&worker.pid, args.front().c_str(), &actions, nullptr, arg_ptrs.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    close(in_fds[0]);
+    if (status != 0)
+    {
+        close(fds[0]);
+        close(in_fds[1]);
+        throw std::runtime_error{std::string{"Could not start a worker process: "} + std::strerror(status)};
+    }
+    worker.pipe_fd = fds[0];
+    worker.input_fd = in_fds[1];
+    return worker;
+}
+
+/*!
+ * \brief Read a fixed number of bytes from a pipe.
+ * \param fd The read end of the pipe.
+ * \param data The buffer that receives the bytes.
+ * \param size The number of bytes.
+ * \return whether all bytes have been read before the pipe was closed.
+ */
+static bool read_exactly(int fd, char * data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t const len = read(fd, data, size);
+        if (len > 0)
+        {
+            data += len;
+            size -= len;
+        }
+        else if (len == 0 || errno != EINTR)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Send the database length to a worker and close its standard input.
+ * \param fd The write end of the pipe.
+ * \param db_len The total length of all shards.
+ */
+static void send_db_length(int fd, uint64_t db_len)
+{
+    char const * data = reinterpret_cast<char const *>(&db_len);
+    size_t size = sizeof(db_len);
+    while (size > 0)
+    {
+        ssize_t const len = write(fd, data, size);
+        if (len > 0)
+        {
+            data += len;
+            size -= len;
+        }
+        else if (errno != EINTR)
+        {
+            break;
+        }
+    }
+    close(fd);
+}
+
+/*!
+ * \brief Read the hit stream of a worker until it closes its standard output.
+ * \param fd The read end of the pipe, which is closed afterwards.
+ * \return the binary stream.
+ */
+static std::string read_pipe(int fd)
+{
+    std::string stream{};
+    std::string buffer(1ul << 16, '\0');
+    while (true)
+    {
+        ssize_t const len = read(fd, buffer.data(), buffer.size());
+        if (len > 0)
+            stream.append(buffer.data(), len);
+        else if (len == 0 || errno != EINTR)
+            break;
+    }
+    close(fd);
+    return stream;
+}
+
+void coordinate_search(Motif const & motif, int argc, char ** argv)
+{
+    // The workers load the segment files, which have to be created first. A new index is split into a segment
+    // for each worker. The coordinator never holds the whole index, which may exceed the memory of one process.
+    if (BiDirectionalIndex::count_segments() == 0)
+        BiDirectionalIndex::create_segment_files(settings.workers);
+    if (!settings.update_file.empty() && BiDirectionalIndex::count_segments() > 0)
+        BiDirectionalIndex::append_segment_file();
+    size_t const segment_count = BiDirectionalIndex::count_segments();
+    if (segment_count == 0)
+    {
+        logger(1, "No genome sequence provided: skipping search step." << std::endl);
+        return;
+    }
+    if (segment_count < settings.workers)
+    {
+        logger(0, "Warning: the index has " << segment_count << " segments, thus only " << segment_count << " of "
+                  << settings.workers << " worker processes are used. Remove the index files to rebuild the index "
+                  << "with a segment for each worker." << std::endl);
+    }
+
+    std::filesystem::path const motif_path = std::filesystem::temp_directory_path() /
+                                             ("mars-" + std::to_string(getpid()) + ".mmo");
+    if (!write_motif(motif, motif_path))
+        throw seqan3::file_open_error{"Could not write the motif for the workers ==> " + motif_path.string()};
+
+    // Launch the workers and read their hit streams concurrently, such that no pipe runs full.
+    size_t const shard_count = std::min<size_t>(settings.workers, segment_count);
+    logger(1, "Stem loop search in " << shard_count << " worker processes...");
+    PhaseReport::Timer search_timer = phase_report.measure("search");
+    auto const tm0 = std::chrono::steady_clock::now();
+    std::vector<WorkerProcess> workers{};
+    std::vector<std::future<std::string>> streams{};
+    std::exception_ptr error{};
+    try
+    {
+        for (size_t shard = 0; shard < shard_count; ++shard)
+        {
+            std::vector<std::string> args(argv, argv + argc);
+            args.insert(args.end(), {"--shard", std::to_string(shard) + "/" + std::to_string(shard_count),
+                                     "--shard-motif", motif_path.string()});
+            workers.push_back(spawn_worker(args));
+        }
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // Each worker sends the text length of its shard after loading it, and receives the total length.
+    uint64_t total_length{0};
+    std::vector<bool> responded(workers.size(), false);
+    for (size_t idx = 0; idx < workers.size(); ++idx)
+    {
+        uint64_t length{0};
+        responded[idx] = read_exactly(workers[idx].pipe_fd, reinterpret_cast<char *>(&length), sizeof(length));
+        total_length += length;
+    }
+    for (size_t idx = 0; idx < workers.size(); ++idx)
+    {
+        if (responded[idx] && !error)
+            send_db_length(workers[idx].input_fd, total_length);
+        else
+            close(workers[idx].input_fd); // the worker terminates without the database length
+        streams.push_back(std::async(std::launch::async, read_pipe, workers[idx].pipe_fd));
+    }
+    bool success{true};
+    for (WorkerProcess const & worker : workers)
+    {
+        int status{};
+        while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+        success = success && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    std::vector<std::string> collected{};
+    for (auto & stream : streams)
+        collected.push_back(stream.get());
+    std::filesystem::remove(motif_path);
+    if (error)
+        std::rethrow_exception(error);
+    if (!success)
+        throw std::runtime_error{"A worker process has failed."};
+    std::vector<ShardResult> results{};
+    for (std::string const & stream : collected)
+        results.push_back(decode_shard_result(stream));
+    search_timer.stop();
+    auto const sec = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - tm0).count();
+    logger(1, " finished (" << sec << "s)." << std::endl);
+
+    // Concatenate the shards, whose sequences are numbered consecutively.
+    std::vector<std::string> names{};
+    std::vector<SearchStats> stats(motif.size());
+    size_t db_len{0};
+    for (ShardResult const & result : results)
+    {
+        names.insert(names.end(), result.names.cbegin(), result.names.cend());
+        db_len += result.text_length;
+        for (size_t idx = 0; idx < std::min(stats.size(), result.stats.size()); ++idx)
+            stats[idx] += result.stats[idx];
+    }
+    StemloopHitStore hits(names.size());
+    size_t first_sequence{0};
+    for (ShardResult & result : results)
+    {
+        for (size_t seq = 0; seq < result.hits.size(); ++seq)
+            hits.get(first_sequence + seq).swap(result.hits[seq]);
+        first_sequence += result.names.size();
+    }
+    if (phase_report.enabled())
+        phase_report.add_memory("hit store", hits.memory_size());
+
+    MotifLocationStore locations(names);
+    merge_all_hits(locations, hits, motif, db_len, names.size());
+    PhaseReport::Timer const timer = phase_report.measure("output");
+    locations.print();
+    store_search_stats(motif, stats);
+}
+
+} // namespace mars
@@ -0,0 +1,73 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "location.hpp"
+#include "motif.hpp"
+#include "search.hpp"
+
+namespace mars
+{
+
+//! \brief The outcome of searching an index shard, which a worker process sends to the coordinator.
+struct ShardResult
+{
+    std::vector<std::string> names; //!< The names of the sequences in the shard.
+    size_t text_length{0}; //!< The total length of the sequences in the shard.
+    std::vector<SearchStats> stats; //!< The search statistics of each stemloop.
+    std::vector<std::vector<StemloopHit>> hits; //!< The hits of each sequence, numbered within the shard.
+};
+
+/*!
+ * \brief Encode the result of a shard in the compact binary hit stream.
+ * \param result The result of the shard; the hits are sorted by position.
+ * \return the binary stream.
+ *
+ * \details
+ * Numbers are stored as variable-length integers and the positions of the hits of a sequence as differences,
+ * such that a typical hit needs about 8 bytes instead of the 24 bytes of a `StemloopHit` in memory.
+ */
+std::string encode_shard_result(ShardResult & result);
+
+/*!
+ * \brief Decode the binary hit stream of a shard.
+ * \param stream The binary stream.
+ * \return the result of the shard.
+ * \throws seqan3::parse_error if the stream is truncated or corrupt.
+ */
+ShardResult decode_shard_result(std::string const & stream);
+
+/*!
+ * \brief Search the index shard given in the settings as a worker process and write the hit stream to stdout.
+ * \throws std::runtime_error if the coordinator does not send the database length.
+ * \details The worker loads the motif that the coordinator has stored and only its share of the index segments.
+ * Then it writes the text length of its share to stdout and reads the total length of all shards from stdin.
+ */
+void search_shard();
+
+/*!
+ * \brief Search the index in worker processes, each of which owns a share of the index segments, and print the
+ *        merged locations.
+ * \param motif The motif to be searched.
+ * \param argc The number of arguments of this program call.
+ * \param argv The arguments of this program call, which are passed on to the workers.
+ * \throws std::runtime_error if a worker process cannot be started or fails.
+ *
+ * \details
+ * The coordinator creates the index files first if they do not exist or the update option is given, where a new
+ * index gets a segment for each worker. The workers are launched as local processes. After loading their shares,
+ * they receive the total database length, which determines the minimum scores of a search e-value, and their hits
+ * are merged with the e-values of the total database length, such that the output equals that of a search in a
+ * single process. There are no more workers than segments, which is reported as a warning.
+ */
+void coordinate_search(Motif const & motif, int argc, char ** argv);
+
+} // namespace mars
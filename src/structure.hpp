@@ -18,7 +18,28 @@
  * \brief Compute the secondary structure of a given multiple structural alignment (MSA).
  * \param names The IDs of the MSA.
  * \param seqs The sequences of the MSA.
+ * \param n_th The number of threads for solving independent regions of the integer program concurrently.
+ * \param alifold Whether the base pair probabilities are computed by folding the alignment once with
+ *                covariation-aware energies (ViennaRNA alifold) instead of averaging CONTRAfold over all sequences.
  * \return two vectors which hold the base pairs and pseudoknot levels.
  */
 std::pair<std::vector<int>, std::vector<int>> run_ipknot(std::list<std::string> const & names,
-                                                         std::list<std::string> const & seqs);
+                                                         std::list<std::string> const & seqs,
+                                                         int n_th,
+                                                         bool alifold);
+
+/*!
+ * \brief Compute the secondary structure of a given MSA with maximum expected accuracy dynamic programming.
+ * \param names The IDs of the MSA.
+ * \param seqs The sequences of the MSA.
+ * \param pseudoknots Whether a greedy pseudoknot layer is predicted on top of the nested structure.
+ * \param alifold Whether the base pair probabilities are computed with ViennaRNA alifold (see run_ipknot).
+ * \return two vectors which hold the base pairs and pseudoknot levels.
+ *
+ * \details
+ * The consensus structure is derived from the base pair probabilities with a gamma-centroid estimator,
+ * which is much faster than solving the integer program of IPknot and does not use GLPK.
+ */
+std::pair<std::vector<int>, std::vector<int>> run_mea(std::list<std::string> const & names,
+                                                      std::list<std::string> const & seqs,
+                                                      bool pseudoknots);
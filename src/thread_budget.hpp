@@ -0,0 +1,105 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+
+namespace mars
+{
+
+/*!
+ * \brief Distributes the number of threads given by the user among the concurrent phases of MaRs.
+ *
+ * The thread pool and the OpenMP regions of IPknot draw from the same budget: long-running tasks reserve the
+ * threads they occupy, and the size of an OpenMP team is limited to the threads that are still available.
+ * The tasks that run concurrently at startup (index creation and folding) are reserved by `main` before any of
+ * them is submitted, and each reservation travels with its task. A reservation never blocks: a task that
+ * needs its calling thread is granted at least one thread, while helper threads may be granted none.
+ */
+class ThreadBudget
+{
+private:
+    //! \brief The mutex for concurrent reservations.
+    std::mutex mutex_budget;
+    //! \brief The number of unreserved threads, may become negative if the budget is exceeded.
+    int available{1};
+
+public:
+    //! \brief A reserved number of threads, which is returned to the budget on destruction.
+    class Reservation
+    {
+    private:
+        //! \brief The budget that granted the threads.
+        ThreadBudget * budget;
+        //! \brief The number of granted threads.
+        int count;
+
+    public:
+        /*!
+         * \brief Constructor for a reservation.
+         * \param budget The budget that granted the threads.
+         * \param count The number of granted threads.
+         */
+        Reservation(ThreadBudget * budget, int count) : budget{budget}, count{count} {}
+
+        Reservation(Reservation const &) = delete;
+        Reservation & operator=(Reservation const &) = delete;
+
+        //! \brief Move constructor that takes over the granted threads.
+        Reservation(Reservation && other) noexcept : budget{other.budget}, count{other.count}
+        {
+            other.count = 0;
+        }
+
+        //! \brief Destructor that releases the granted threads.
+        ~Reservation()
+        {
+            if (count > 0)
+            {
+                std::lock_guard<std::mutex> guard(budget->mutex_budget);
+                budget->available += count;
+            }
+        }
+
+        //! \brief The number of granted threads.
+        int size() const
+        {
+            return count;
+        }
+    };
+
+    /*!
+     * \brief Set the total number of threads.
+     * \param total The number of threads that MaRs may use concurrently.
+     */
+    void reset(unsigned int total)
+    {
+        std::lock_guard<std::mutex> guard(mutex_budget);
+        available = std::max(1, static_cast<int>(total));
+    }
+
+    /*!
+     * \brief Reserve threads for a task.
+     * \param requested The number of threads that the task would like to use.
+     * \param minimum The number of threads that are granted even if the budget is exhausted.
+     * \return A reservation of at most `requested` threads, but at least `minimum`.
+     */
+    Reservation reserve(unsigned int requested, unsigned int minimum = 1)
+    {
+        std::lock_guard<std::mutex> guard(mutex_budget);
+        int const granted = std::max(static_cast<int>(minimum), std::min(available, static_cast<int>(requested)));
+        available -= granted;
+        return Reservation{this, granted};
+    }
+};
+
+//! \brief The thread budget shared by the thread pool and the OpenMP regions.
+extern ThreadBudget thread_budget;
+
+} // namespace mars
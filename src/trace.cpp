@@ -0,0 +1,63 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include <seqan3/io/exception.hpp>
+
+#include "trace.hpp"
+
+namespace mars
+{
+
+Tracer tracer{};
+
+Tracer::ThreadBuffer & Tracer::local_buffer()
+{
+    thread_local ThreadBuffer * buffer{nullptr};
+    if (buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(mutex_buffers);
+        buffers.push_back(std::make_unique<ThreadBuffer>(ThreadBuffer{buffers.size(), 0ul, {}}));
+        buffer = buffers.back().get();
+        buffer->events.resize(capacity);
+    }
+    return *buffer;
+}
+
+void Tracer::write(std::filesystem::path const & filepath) const
+{
+    std::ofstream ofs{filepath};
+    if (!ofs)
+        throw seqan3::file_open_error{"Could not write the trace ==> " + filepath.string()};
+
+    std::lock_guard<std::mutex> guard(mutex_buffers);
+    ofs << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (auto const & buffer : buffers)
+    {
+        ofs << (first ? "\n" : ",\n")
+            << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+            << ", \"args\": {\"name\": \"" << (buffer->tid == 0 ? "main" : "thread") << " " << buffer->tid << "\"}}";
+        first = false;
+
+        // In a full ring buffer the oldest event is located at the current write position.
+        size_t const num = std::min(buffer->count, capacity);
+        for (size_t idx = buffer->count - num; idx < buffer->count; ++idx)
+        {
+            TraceEvent const & event = buffer->events[idx % capacity];
+            ofs << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid
+                << ", \"ts\": " << event.begin_ns / 1e3 << ", \"dur\": " << event.duration_ns / 1e3 << "}";
+        }
+    }
+    ofs << "\n]}\n";
+}
+
+} // namespace mars
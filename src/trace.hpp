@@ -0,0 +1,143 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <seqan3/std/filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mars
+{
+
+//! \brief A completed task or phase on the timeline of a thread.
+struct TraceEvent
+{
+    char const * name; //!< The name of the event, a string literal.
+    char const * category; //!< The category of the event, a string literal.
+    uint64_t begin_ns; //!< The start time in nanoseconds since the tracer has been enabled.
+    uint64_t duration_ns; //!< The duration in nanoseconds.
+};
+
+/*!
+ * \brief Records a timeline of the tasks and phases of each thread and writes it in the Chrome trace event format.
+ *
+ * \details
+ * Each thread records into its own ring buffer, such that recording needs no synchronization. If a thread records
+ * more events than the buffer can hold, the oldest events are overwritten. The trace can be viewed with
+ * chrome://tracing or https://ui.perfetto.dev.
+ */
+class Tracer
+{
+private:
+    //! \brief The number of events that each thread keeps.
+    static constexpr size_t capacity{1ul << 16};
+
+    //! \brief The ring buffer of a single thread.
+    struct ThreadBuffer
+    {
+        size_t tid; //!< The thread number in the trace.
+        size_t count; //!< The number of recorded events, which may exceed the capacity.
+        std::vector<TraceEvent> events; //!< The storage for the events.
+    };
+
+    //! \brief The mutex for registering new threads.
+    mutable std::mutex mutex_buffers;
+    //! \brief The buffers of all threads that have recorded events.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    //! \brief The reference point of the timestamps.
+    std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+    //! \brief Whether events are recorded.
+    bool active{false};
+
+    //! \brief The buffer of the calling thread, which is registered on first access.
+    ThreadBuffer & local_buffer();
+
+public:
+    //! \brief Start recording events. Must be called from the main thread before any tasks are running.
+    void enable()
+    {
+        start = std::chrono::steady_clock::now();
+        active = true;
+        local_buffer(); // the main thread becomes thread 0
+    }
+
+    //! \brief Whether events are recorded.
+    bool enabled() const
+    {
+        return active;
+    }
+
+    //! \brief The current timestamp in nanoseconds.
+    uint64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /*!
+     * \brief Record an event for the calling thread.
+     * \param name The name of the event, a string literal.
+     * \param category The category of the event, a string literal.
+     * \param begin_ns The start time of the event.
+     * \param end_ns The end time of the event.
+     */
+    void record(char const * name, char const * category, uint64_t begin_ns, uint64_t end_ns)
+    {
+        ThreadBuffer & buffer = local_buffer();
+        buffer.events[buffer.count % capacity] = TraceEvent{name, category, begin_ns, end_ns - begin_ns};
+        ++buffer.count;
+    }
+
+    /*!
+     * \brief Write the recorded events in the Chrome trace event format. Must be called after all tasks are done.
+     * \param filepath The output file.
+     * \throws seqan3::file_open_error if the file cannot be written.
+     */
+    void write(std::filesystem::path const & filepath) const;
+};
+
+//! \brief The tracer of the MaRs run.
+extern Tracer tracer;
+
+//! \brief Records the lifetime of a scope as a trace event, if tracing is enabled.
+class TraceScope
+{
+private:
+    //! \brief The name of the event.
+    char const * name;
+    //! \brief The category of the event.
+    char const * category;
+    //! \brief The start time, or UINT64_MAX if tracing is disabled.
+    uint64_t begin_ns;
+
+public:
+    /*!
+     * \brief Start recording a scope.
+     * \param name The name of the event, a string literal.
+     * \param category The category of the event, a string literal.
+     */
+    explicit TraceScope(char const * name, char const * category = "task") :
+        name{name},
+        category{category},
+        begin_ns{tracer.enabled() ? tracer.now() : UINT64_MAX}
+    {}
+
+    TraceScope(TraceScope const &) = delete;
+    TraceScope & operator=(TraceScope const &) = delete;
+
+    //! \brief Destructor that records the event.
+    ~TraceScope()
+    {
+        if (begin_ns != UINT64_MAX)
+            tracer.record(name, category, begin_ns, tracer.now());
+    }
+};
+
+} // namespace mars
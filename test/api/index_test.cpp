@@ -7,10 +7,16 @@
 
 #include <gtest/gtest.h>
 
+#include <seqan3/std/algorithm>
+#include <fstream>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
 #include <seqan3/alphabet/nucleotide/rna4.hpp>
 
 #include "bi_alphabet.hpp"
+#include "block_file.hpp"
 #include "index.hpp"
+#include "packed_text.hpp"
 #include "search.hpp"
 #include "settings.hpp"
 
@@ -28,25 +34,304 @@ TEST(Index, Create)
     mars::settings.compress_index = true;
     mars::settings.verbose = 0u;
     EXPECT_NO_THROW(bds.create());
-#ifdef SEQAN3_HAS_ZLIB
-    std::filesystem::path const indexfile = data("genome.fa.marsindex.gz");
-#else
     std::filesystem::path const indexfile = data("genome.fa.marsindex");
-#endif
     EXPECT_TRUE(std::filesystem::exists(indexfile));
+    EXPECT_TRUE(mars::BlockFileReader::is_block_file(indexfile));
+
+    // from block-compressed archive
+    mars::BiDirectionalIndex bds_restored{};
+    EXPECT_NO_THROW(bds_restored.create());
+    EXPECT_EQ(bds_restored.get_names(), bds.get_names());
+    EXPECT_EQ(bds_restored.text_length(), bds.text_length());
     std::filesystem::remove(indexfile);
 
     // from archive
     mars::settings.genome_file = data("genome2.fa");
     EXPECT_NO_THROW(bds.create());
 
-    // from compressed archive
+    // from legacy gzip archive
 #ifdef SEQAN3_HAS_ZLIB
     mars::settings.genome_file = data("genome3.fa");
     EXPECT_NO_THROW(bds.create());
 #endif
 }
 
+TEST(Index, Segments)
+{
+    mars::settings.genome_file = data("genome.fa");
+    mars::settings.compress_index = true;
+    mars::settings.verbose = 0u;
+    mars::settings.update_file.clear();
+    size_t base_names{};
+    size_t base_length{};
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        base_names = bds.get_names().size();
+        base_length = bds.text_length();
+    }
+
+    // add the genome again as new segments, where the fourth small segment triggers the compaction
+    mars::settings.update_file = data("genome.fa");
+    for (size_t num = 1; num <= 4; ++num)
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        ASSERT_EQ(bds.get_segments().size(), num + 1);
+        EXPECT_EQ(bds.get_segments().back().first_sequence, num * base_names);
+        EXPECT_EQ(bds.get_names().size(), (num + 1) * base_names);
+        EXPECT_EQ(bds.text_length(), (num + 1) * base_length);
+    }
+
+    // the small segments have been merged into one
+    mars::settings.update_file.clear();
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_segments().size(), 2u);
+        EXPECT_EQ(bds.get_names().size(), 5 * base_names);
+        EXPECT_EQ(bds.text_length(), 5 * base_length);
+    }
+    EXPECT_FALSE(std::filesystem::exists(data("genome.fa.marsindex.2")));
+    std::filesystem::remove(data("genome.fa.marsindex"));
+    std::filesystem::remove(data("genome.fa.marsindex.1"));
+}
+
+TEST(Index, WorkerSegments)
+{
+    // a new index gets a segment for each worker, but not more segments than sequences
+    mars::settings.genome_file = data("genome.fa");
+    mars::settings.compress_index = true;
+    mars::settings.verbose = 0u;
+    mars::settings.update_file.clear();
+    mars::BiDirectionalIndex single{};
+    EXPECT_NO_THROW(single.create());
+    std::filesystem::remove(data("genome.fa.marsindex"));
+
+    for (size_t workers : {2ul, 5ul})
+    {
+        size_t const count = std::min<size_t>(workers, single.get_names().size());
+        EXPECT_NO_THROW(mars::BiDirectionalIndex::create_segment_files(workers));
+        EXPECT_EQ(mars::BiDirectionalIndex::count_segments(), count);
+
+        // the segments are restored in order
+        {
+            mars::BiDirectionalIndex bds{};
+            EXPECT_NO_THROW(bds.create());
+            EXPECT_EQ(bds.get_segments().size(), count);
+            EXPECT_EQ(bds.get_segments()[1].first_sequence, bds.get_segments()[0].sequence_count);
+            EXPECT_EQ(bds.get_names(), single.get_names());
+            EXPECT_EQ(bds.text_length(), single.text_length());
+        }
+
+        // an update is appended as a further segment file
+        mars::settings.update_file = data("genome.fa");
+        EXPECT_NO_THROW(mars::BiDirectionalIndex::append_segment_file());
+        mars::settings.update_file.clear();
+        EXPECT_EQ(mars::BiDirectionalIndex::count_segments(), count + 1);
+        {
+            mars::BiDirectionalIndex bds{};
+            EXPECT_NO_THROW(bds.create());
+            EXPECT_EQ(bds.get_names().size(), 2 * single.get_names().size());
+            EXPECT_EQ(bds.text_length(), 2 * single.text_length());
+        }
+        std::filesystem::remove(data("genome.fa.marsindex"));
+        for (size_t num = 1; num <= count; ++num)
+            std::filesystem::remove(data("genome.fa.marsindex." + std::to_string(num)));
+    }
+}
+
+TEST(Index, InterruptedCompaction)
+{
+    mars::settings.genome_file = data("genome.fa");
+    mars::settings.compress_index = true;
+    mars::settings.verbose = 0u;
+    mars::settings.update_file.clear();
+    size_t base_names{};
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        base_names = bds.get_names().size();
+    }
+
+    // keep copies of a small segment and of the merged segment
+    auto segment = [] (size_t num) { return data("genome.fa.marsindex." + std::to_string(num)); };
+    std::filesystem::path const small_copy = data("genome.fa.small");
+    std::filesystem::path const merged_copy = data("genome.fa.merged");
+    std::filesystem::path const merged_file = data("genome.fa.marsindex.compact");
+    std::filesystem::path const journal_file = data("genome.fa.marsindex.compaction");
+    auto const copy = std::filesystem::copy_options::overwrite_existing;
+    mars::settings.update_file = data("genome.fa");
+    for (size_t num = 1; num <= 4; ++num)
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        if (num == 1)
+            std::filesystem::copy_file(segment(1), small_copy, copy);
+    }
+    std::filesystem::copy_file(segment(1), merged_copy, copy);
+    mars::settings.update_file.clear();
+
+    auto expect_merged = [&] ()
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_segments().size(), 2u);
+        EXPECT_EQ(bds.get_names().size(), 5 * base_names);
+        EXPECT_TRUE(std::filesystem::exists(segment(1)));
+        EXPECT_FALSE(std::filesystem::exists(segment(2)));
+        EXPECT_FALSE(std::filesystem::exists(segment(4)));
+        EXPECT_FALSE(std::filesystem::exists(journal_file));
+        EXPECT_FALSE(std::filesystem::exists(merged_file));
+    };
+
+    // interrupted after the commit, before the merged segment has been renamed
+    for (size_t num = 1; num <= 4; ++num)
+        std::filesystem::copy_file(small_copy, segment(num), copy);
+    std::filesystem::copy_file(merged_copy, merged_file, copy);
+    std::ofstream{journal_file} << "1\n2\n3\n4\n";
+    expect_merged();
+
+    // interrupted while the small segments are removed
+    std::filesystem::copy_file(small_copy, segment(3), copy);
+    std::ofstream{journal_file} << "1\n2\n3\n4\n";
+    expect_merged();
+
+    // interrupted before the commit: the small segments are read and compacted again
+    for (size_t num = 1; num <= 4; ++num)
+        std::filesystem::copy_file(small_copy, segment(num), copy);
+    std::filesystem::copy_file(small_copy, merged_file, copy);
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_segments().size(), 5u);
+        EXPECT_EQ(bds.get_names().size(), 5 * base_names);
+    }
+    expect_merged();
+
+    // gaps in the segment numbers are skipped, and new segments are appended after the last one
+    std::filesystem::rename(segment(1), segment(7));
+    mars::settings.update_file = data("genome.fa");
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_segments().size(), 3u);
+        EXPECT_EQ(bds.get_names().size(), 6 * base_names);
+    }
+    EXPECT_TRUE(std::filesystem::exists(segment(8)));
+    mars::settings.update_file.clear();
+
+    for (std::filesystem::path const & file : {data("genome.fa.marsindex"), segment(7), segment(8), small_copy,
+                                                merged_copy})
+        std::filesystem::remove(file);
+}
+
+TEST(Index, Cache)
+{
+    std::filesystem::path const cache_dir = data("index_cache");
+    mars::settings.genome_file = data("genome.fa");
+    mars::settings.index_cache = cache_dir;
+    mars::settings.compress_index = false;
+    mars::settings.update_file.clear();
+    mars::settings.verbose = 0u;
+
+    // the first run creates the index in the cache, the second run loads it
+    std::vector<std::string> names{};
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        names = bds.get_names();
+    }
+    EXPECT_FALSE(std::filesystem::exists(data("genome.fa.marsindex")));
+    auto count_files = [&cache_dir] ()
+    {
+        return std::distance(std::filesystem::directory_iterator{cache_dir}, std::filesystem::directory_iterator{});
+    };
+    EXPECT_EQ(count_files(), 1);
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_names(), names);
+    }
+    EXPECT_EQ(count_files(), 1);
+
+    // a truncated entry is a cache miss and it is rebuilt
+    std::filesystem::path const entry = std::filesystem::directory_iterator{cache_dir}->path();
+    std::filesystem::resize_file(entry, std::filesystem::file_size(entry) / 2);
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_names(), names);
+    }
+    EXPECT_EQ(count_files(), 1);
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_names(), names);
+    }
+
+    // the same content is a cache hit, which becomes a second segment
+    mars::settings.update_file = data("genome.fa");
+    {
+        mars::BiDirectionalIndex bds{};
+        EXPECT_NO_THROW(bds.create());
+        EXPECT_EQ(bds.get_segments().size(), 2u);
+        EXPECT_EQ(bds.get_names().size(), 2 * names.size());
+    }
+    EXPECT_EQ(count_files(), 1);
+
+    mars::settings.update_file.clear();
+    mars::settings.index_cache.clear();
+    std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Index, BlockFile)
+{
+    // a component that spans several blocks, an empty and a small component
+    std::string large(3'000'000, '\0');
+    for (size_t idx = 0; idx < large.size(); ++idx)
+        large[idx] = static_cast<char>(idx * 7 % 251);
+    std::filesystem::path const blockfile = data("components.blk");
+    {
+        mars::BlockFileWriter writer{};
+        writer.add("large", large);
+        writer.add("empty", "");
+        writer.add("small", "MaRs");
+        EXPECT_NO_THROW(writer.write(blockfile));
+    }
+    EXPECT_TRUE(mars::BlockFileReader::is_block_file(blockfile));
+    EXPECT_FALSE(mars::BlockFileReader::is_block_file(data("genome.fa")));
+
+    mars::BlockFileReader const reader{blockfile};
+    EXPECT_TRUE(reader.contains("small"));
+    EXPECT_FALSE(reader.contains("names"));
+    EXPECT_EQ(reader.read("small"), "MaRs");
+    EXPECT_EQ(reader.read("empty"), "");
+    EXPECT_EQ(reader.read("large"), large);
+    EXPECT_THROW(reader.read("names"), seqan3::parse_error);
+    std::filesystem::remove(blockfile);
+}
+
+TEST(Index, PackedText)
+{
+    using seqan3::operator""_dna4;
+
+    // sequences that do not end at word boundaries
+    std::vector<seqan3::dna4_vector> const seqs{"ACGTTGCA"_dna4, "GATTACAGATTACAGATTACAGATTACAGATTACAGATTACA"_dna4};
+    mars::PackedText text{};
+    for (auto const & seq : seqs)
+        text.push_back(seq);
+    ASSERT_EQ(text.sequence_count(), seqs.size());
+    EXPECT_EQ(text.size(), 50u);
+    EXPECT_EQ(text.sequence_begin(1), 8u);
+    for (size_t idx = 0; idx < seqs.size(); ++idx)
+        EXPECT_TRUE(std::ranges::equal(text.sequence(idx), seqs[idx]));
+
+    // the index of the packed text equals the index of the unpacked sequences
+    mars::Index const index{text.sequences()};
+    EXPECT_EQ(index.size(), mars::Index{seqs}.size());
+}
+
 //TEST(Index, BiDirectionalIndex)
 //{
 //    using seqan3::operator""_rna4;
@@ -175,3 +175,14 @@ TEST(StockholmInput, ReadFile)
     EXPECT_RANGE_EQ(msa.structure.first, basepairs);
     EXPECT_RANGE_EQ(msa.structure.second, pklevels);
 }
+
+TEST(ClustalInput, SelectDiverseRows)
+{
+    mars::Msa msa = mars::read_clustal_file<seqan3::rna15>(data("tRNA.aln"));
+
+    // Row 2 has the lowest identity to the first row.
+    EXPECT_RANGE_EQ(mars::select_diverse_rows(msa, 1), (std::vector<size_t>{0}));
+    EXPECT_RANGE_EQ(mars::select_diverse_rows(msa, 2), (std::vector<size_t>{0, 2}));
+    EXPECT_RANGE_EQ(mars::select_diverse_rows(msa, 5), (std::vector<size_t>{0, 1, 2, 3, 4}));
+    EXPECT_RANGE_EQ(mars::select_diverse_rows(msa, 9), (std::vector<size_t>{0, 1, 2, 3, 4}));
+}
@@ -7,7 +7,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
 #include <seqan3/std/iterator>
+#include <random>
 #include <vector>
 
 #include <seqan3/alphabet/gap/gapped.hpp>
@@ -15,6 +18,7 @@
 #include <seqan3/alphabet/views/char_to.hpp>
 #include <seqan3/test/expect_range_eq.hpp>
 
+#include "calibration.hpp"
 #include "motif.hpp"
 #include "multiple_alignment.hpp"
 
@@ -144,3 +148,41 @@ TEST(Motif, AnalyzeStemLoop)
     EXPECT_EQ(gap_entry->first, 4);
     EXPECT_EQ(gap_entry->second, 4u);
 }
+
+TEST(Motif, Calibration)
+{
+    // sample the maxima of a known Gumbel distribution by inverting its cumulative distribution function
+    float const lambda{0.8f};
+    float const mu{5.f};
+    std::mt19937_64 generator{42};
+    std::uniform_real_distribution<double> uniform{0., 1.};
+    std::vector<float> maxima(20000);
+    for (float & score : maxima)
+        score = static_cast<float>(mu - std::log(-std::log(uniform(generator))) / lambda);
+
+    mars::ScoreCalibration const calibration = mars::fit_gumbel(maxima, maxima.size(), 1000u);
+    ASSERT_TRUE(calibration.valid());
+    EXPECT_NEAR(calibration.lambda, lambda, 0.05f);
+    EXPECT_NEAR(calibration.mu, mu, 0.1f);
+
+    // larger databases and smaller e-values require higher scores
+    float const min_score = calibration.min_score(1000000u, 1.);
+    EXPECT_GT(min_score, calibration.min_score(100000u, 1.));
+    EXPECT_GT(calibration.min_score(1000000u, 0.1), min_score);
+    EXPECT_NEAR(min_score, mu + std::log(1000.) / lambda, 0.2f);
+
+    // without calibration or with too many tolerated chance hits nothing is pruned
+    EXPECT_EQ(mars::ScoreCalibration{}.min_score(1000000u, 1.), 0.f);
+    EXPECT_EQ(calibration.min_score(1000u, 10.), 0.f);
+    EXPECT_FALSE(mars::fit_gumbel(std::vector<float>(10, 1.f), 10u, 1000u).valid());
+    EXPECT_FALSE(mars::fit_gumbel({3.f}, 256u, 1000u).valid());
+
+    // windows without a hit are censored: the maxima below a threshold are unknown, which does not bias the fit
+    std::vector<float> observed{};
+    std::copy_if(maxima.begin(), maxima.end(), std::back_inserter(observed), [] (float score) { return score > 5.5f; });
+    ASSERT_LT(observed.size(), maxima.size() * 3 / 4);
+    mars::ScoreCalibration const censored = mars::fit_gumbel(observed, maxima.size(), 1000u);
+    ASSERT_TRUE(censored.valid());
+    EXPECT_NEAR(censored.lambda, lambda, 0.05f);
+    EXPECT_NEAR(censored.mu, mu, 0.1f);
+}
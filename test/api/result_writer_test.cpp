@@ -0,0 +1,103 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "result_writer.hpp"
+
+//! \brief Write two locations in the given format and return the output.
+static std::string write_locations(mars::ResultFormat format, std::vector<std::string> const & names)
+{
+    std::ostringstream out{};
+    {
+        mars::ResultWriter writer{out, format, names};
+        writer.write({1e-5, 42.5f, 3, 100, 150, 40, 0});
+        writer.write({INFINITY, 2000.f, 1, 0, 10, 10, 1});
+    }
+    return out.str();
+}
+
+TEST(ResultWriter, Format)
+{
+    EXPECT_EQ(mars::result_format("out.bed"), mars::ResultFormat::bed);
+    EXPECT_EQ(mars::result_format("out.GFF"), mars::ResultFormat::gff3);
+    EXPECT_EQ(mars::result_format("out.gff3"), mars::ResultFormat::gff3);
+    EXPECT_EQ(mars::result_format("out.jsonl"), mars::ResultFormat::jsonl);
+    EXPECT_EQ(mars::result_format("out.ndjson"), mars::ResultFormat::jsonl);
+    EXPECT_EQ(mars::result_format("out.txt"), mars::ResultFormat::tsv);
+    EXPECT_EQ(mars::result_format(""), mars::ResultFormat::tsv);
+}
+
+TEST(ResultWriter, Bed)
+{
+    // 0-based, half-open coordinates, and the score is clamped to 1000
+    EXPECT_EQ(write_locations(mars::ResultFormat::bed, {"chr1", "chr2"}),
+              "chr1\t100\t150\tmars1\t43\t+\n"
+              "chr2\t0\t10\tmars2\t1000\t+\n");
+}
+
+TEST(ResultWriter, Gff3)
+{
+    // 1-based, closed coordinates
+    EXPECT_EQ(write_locations(mars::ResultFormat::gff3, {"chr1", "chr2"}),
+              "##gff-version 3\n"
+              "chr1\tMaRs\tmatch\t101\t150\t42.5\t+\t.\tID=mars1;evalue=1e-05;stemloops=3;query_length=40\n"
+              "chr2\tMaRs\tmatch\t1\t10\t2000\t+\t.\tID=mars2;evalue=inf;stemloops=1;query_length=10\n");
+}
+
+TEST(ResultWriter, Gff3Escaping)
+{
+    // characters outside of the allowed set are percent-encoded
+    std::string const out = write_locations(mars::ResultFormat::gff3, {"chr 1;a=b%\t", "x.y:z|_-"});
+    EXPECT_EQ(out.substr(out.find('\n') + 1, out.find('\t', out.find('\n')) - out.find('\n') - 1),
+              "chr%201%3Ba%3Db%25%09");
+    EXPECT_NE(out.find("\nx.y:z|_-\tMaRs"), std::string::npos);
+}
+
+TEST(ResultWriter, Jsonl)
+{
+    // the infinite e-value is not representable in JSON
+    EXPECT_EQ(write_locations(mars::ResultFormat::jsonl, {"chr1", "chr2"}),
+              "{\"sequence\":\"chr1\",\"index\":0,\"start\":100,\"end\":150,\"query_length\":40,\"stemloops\":3,"
+              "\"score\":42.5,\"evalue\":1e-05}\n"
+              "{\"sequence\":\"chr2\",\"index\":1,\"start\":0,\"end\":10,\"query_length\":10,\"stemloops\":1,"
+              "\"score\":2000,\"evalue\":null}\n");
+}
+
+TEST(ResultWriter, JsonEscaping)
+{
+    std::string const out = write_locations(mars::ResultFormat::jsonl, {"a\"b\\c\td\x01", "ü"});
+    EXPECT_EQ(out.substr(0, out.find(",\"index\"")), "{\"sequence\":\"a\\\"b\\\\c\\u0009d\\u0001\"");
+    EXPECT_NE(out.find("\n{\"sequence\":\"ü\",\"index\":1,"), std::string::npos); // UTF-8 is kept
+}
+
+TEST(ResultWriter, Tsv)
+{
+    std::string const out = write_locations(mars::ResultFormat::tsv, {"chr1", "chr2"});
+    EXPECT_EQ(out.substr(0, out.find('\n')),
+              "sequence name                      \tindex\tpos\tend\tqlen\tn\tscore\te-value");
+    EXPECT_NE(out.find("\nchr1" + std::string(31, ' ') + "\t0\t100\t150\t40\t3\t42.5\t1e-05\n"), std::string::npos);
+}
+
+TEST(ResultWriter, LargeOutput)
+{
+    // many rows are handed over to the background thread in several chunks
+    std::vector<std::string> const names{"chr1"};
+    std::ostringstream out{};
+    {
+        mars::ResultWriter writer{out, mars::ResultFormat::bed, names};
+        for (size_t idx = 0; idx < 100000; ++idx)
+            writer.write({1., 1.f, 1, idx, idx + 1, 1, 0});
+    }
+    std::string const str = out.str();
+    EXPECT_EQ(std::count(str.begin(), str.end(), '\n'), 100000);
+    EXPECT_EQ(str.substr(str.rfind('\n', str.size() - 2) + 1), "chr1\t99999\t100000\tmars100000\t1\t+\n");
+}
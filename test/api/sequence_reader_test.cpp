@@ -0,0 +1,286 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+
+#include <seqan3/std/algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifdef SEQAN3_HAS_ZLIB
+    #include <zlib.h>
+#endif
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+#include <seqan3/io/exception.hpp>
+#include <seqan3/io/sequence_file/input.hpp>
+
+#include "packed_text.hpp"
+#include "sequence_reader.hpp"
+
+// Generate the full path of a test input file that is provided in the data directory.
+std::filesystem::path data(std::string const & filename)
+{
+    return std::filesystem::path{std::string{DATADIR}}.concat(filename);
+}
+
+//! \brief The sequences and names that have been read from a file.
+struct Sequences
+{
+    std::vector<std::string> names{};
+    std::vector<seqan3::dna4_vector> seqs{};
+};
+
+//! \brief Read a file with the parallel reader, which must support its format.
+static Sequences read_parallel(std::filesystem::path const & filepath)
+{
+    mars::PackedText text{};
+    Sequences result{};
+    EXPECT_TRUE(mars::read_sequences_parallel(filepath, text, result.names));
+    result.seqs.resize(text.sequence_count());
+    for (size_t idx = 0; idx < text.sequence_count(); ++idx)
+        std::ranges::copy(text.sequence(idx), std::back_inserter(result.seqs[idx]));
+    return result;
+}
+
+//! \brief Read a FASTA file with the seqan3 reader, as MaRs does for unsupported formats.
+static Sequences read_seqan3(std::filesystem::path const & filepath)
+{
+    struct dna4_traits : seqan3::sequence_file_input_default_traits_dna
+    {
+        using sequence_alphabet = seqan3::dna4;
+    };
+    using fields = seqan3::fields<seqan3::field::seq, seqan3::field::id>;
+    std::ifstream ifs{filepath};
+    seqan3::sequence_file_input<dna4_traits, fields> reader{ifs, seqan3::format_fasta()};
+    reader.options.truncate_ids = true;
+    Sequences result{};
+    for (auto & [seq, name] : reader)
+    {
+        result.seqs.push_back(std::move(seq));
+        result.names.push_back(std::move(name));
+    }
+    return result;
+}
+
+//! \brief Write a string into a file.
+static void write_file(std::filesystem::path const & filepath, std::string const & content)
+{
+    std::ofstream ofs{filepath, std::ios::binary};
+    ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+//! \brief Read a whole file into a string.
+static std::string read_file(std::filesystem::path const & filepath)
+{
+    std::ifstream ifs{filepath, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+}
+
+/*!
+ * \brief Generate a UCSC 2bit file.
+ * \param records The names and sequences, where N runs become N blocks and lower case runs become mask blocks.
+ * \param swap Whether the file uses the opposite byte order.
+ */
+static std::string twobit(std::vector<std::pair<std::string, std::string>> const & records, bool swap)
+{
+    std::string out{};
+    auto put32 = [&out, swap] (uint32_t value)
+    {
+        if (swap)
+            value = __builtin_bswap32(value);
+        out.append(reinterpret_cast<char const *>(&value), 4);
+    };
+    auto runs = [] (std::string const & seq, auto predicate)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> result{};
+        for (size_t pos = 0; pos < seq.size(); ++pos)
+        {
+            if (!predicate(seq[pos]))
+                continue;
+            if (result.empty() || result.back().first + result.back().second != pos)
+                result.emplace_back(pos, 0);
+            ++result.back().second;
+        }
+        return result;
+    };
+
+    put32(0x1A412743);
+    put32(0);
+    put32(records.size());
+    put32(0);
+    size_t offset = out.size();
+    for (auto const & [name, seq] : records)
+        offset += 1 + name.size() + 4;
+    std::string body{};
+    for (auto const & [name, seq] : records)
+    {
+        out.push_back(static_cast<char>(name.size()));
+        out.append(name);
+        put32(offset + body.size());
+
+        std::swap(out, body);
+        auto const n_blocks = runs(seq, [] (char chr) { return chr == 'N' || chr == 'n'; });
+        auto const mask_blocks = runs(seq, [] (char chr) { return std::islower(chr) != 0; });
+        put32(seq.size());
+        for (auto const & blocks : {n_blocks, mask_blocks})
+        {
+            put32(blocks.size());
+            for (auto const & block : blocks)
+                put32(block.first);
+            for (auto const & block : blocks)
+                put32(block.second);
+        }
+        put32(0);
+        std::string const codes{"TCAG"};
+        for (size_t pos = 0; pos < seq.size(); pos += 4)
+        {
+            uint8_t byte{0};
+            for (size_t idx = pos; idx < pos + 4; ++idx)
+            {
+                size_t const code = idx < seq.size() ? codes.find(static_cast<char>(std::toupper(seq[idx]))) : 0;
+                byte = static_cast<uint8_t>((byte << 2) | (code == std::string::npos ? 0 : code));
+            }
+            out.push_back(static_cast<char>(byte));
+        }
+        std::swap(out, body);
+    }
+    return out + body;
+}
+
+TEST(SequenceReader, TwoBit)
+{
+    using seqan3::operator""_dna4;
+
+    std::vector<std::pair<std::string, std::string>> const records{{"chr1", "ACGTNNNNacgtA"},
+                                                                   {"chr2", ""},
+                                                                   {"unplaced", "nnGGCCttaa"}};
+    std::vector<seqan3::dna4_vector> const expected{"ACGTAAAAACGTA"_dna4, ""_dna4, "AAGGCCTTAA"_dna4};
+    std::filesystem::path const filepath = data("sequences.2bit");
+    for (bool swap : {false, true})
+    {
+        write_file(filepath, twobit(records, swap));
+        Sequences const result = read_parallel(filepath);
+        EXPECT_EQ(result.names, (std::vector<std::string>{"chr1", "chr2", "unplaced"}));
+        EXPECT_EQ(result.seqs, expected);
+    }
+
+    // a truncated file is detected
+    std::string const content = twobit(records, false);
+    write_file(filepath, content.substr(0, content.size() - 2));
+    mars::PackedText text{};
+    std::vector<std::string> names{};
+    EXPECT_THROW(mars::read_sequences_parallel(filepath, text, names), seqan3::parse_error);
+    std::filesystem::remove(filepath);
+}
+
+TEST(SequenceReader, Fasta)
+{
+    using seqan3::operator""_dna4;
+
+    // CRLF line endings, an empty record, whitespace and digits within the sequence, and IUPAC codes
+    std::filesystem::path const filepath = data("sequences.fa");
+    write_file(filepath, "\r\n>seq1 description\r\nACGU\r\nacgt\r\n>empty\r\n>seq3\tx\r\nAC GT 10\r\nRYKMN\r\n>last");
+    Sequences const result = read_parallel(filepath);
+    EXPECT_EQ(result.names, (std::vector<std::string>{"seq1", "empty", "seq3", "last"}));
+    EXPECT_EQ(result.seqs,
+              (std::vector<seqan3::dna4_vector>{"ACGTACGT"_dna4, ""_dna4, "ACGTACGAA"_dna4, ""_dna4}));
+
+    // characters that are not nucleotides are rejected, like by the seqan3 reader
+    for (std::string const seq : {"ACXT", "AC-T", "AC*T"})
+    {
+        write_file(filepath, ">seq\nACGT\n" + seq + "\n");
+        mars::PackedText text{};
+        std::vector<std::string> names{};
+        EXPECT_THROW(mars::read_sequences_parallel(filepath, text, names), seqan3::parse_error);
+        EXPECT_THROW(read_seqan3(filepath), seqan3::parse_error);
+    }
+
+    // other formats are left to the caller
+    write_file(filepath, "ACGT\n");
+    mars::PackedText text{};
+    std::vector<std::string> names{};
+    EXPECT_FALSE(mars::read_sequences_parallel(filepath, text, names));
+    EXPECT_EQ(text.sequence_count(), 0u);
+    EXPECT_TRUE(names.empty());
+    std::filesystem::remove(filepath);
+}
+
+TEST(SequenceReader, Seqan3)
+{
+    // the parallel reader yields the same sequences as the seqan3 reader
+    Sequences const expected = read_seqan3(data("genome.fa"));
+    Sequences const result = read_parallel(data("genome.fa"));
+    EXPECT_EQ(result.names, expected.names);
+    EXPECT_EQ(result.seqs, expected.seqs);
+}
+
+#ifdef SEQAN3_HAS_ZLIB
+/*!
+ * \brief Compress data into a gzip member or a BGZF block.
+ * \param data The uncompressed data.
+ * \param bgzf Whether to generate a BGZF block, which stores its size in an extra field.
+ */
+static std::string deflate_member(std::string_view data, bool bgzf)
+{
+    std::string deflated(compressBound(data.size()) + 64, '\0');
+    z_stream stream{};
+    EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, bgzf ? -MAX_WBITS : MAX_WBITS + 16, 8,
+                           Z_DEFAULT_STRATEGY), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(deflated.data());
+    stream.avail_out = deflated.size();
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (!bgzf)
+        return deflated;
+
+    auto put = [] (std::string & out, uint32_t value, size_t bytes)
+    {
+        for (size_t idx = 0; idx < bytes; ++idx)
+            out.push_back(static_cast<char>((value >> (8 * idx)) & 0xff));
+    };
+    std::string block{"\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16};
+    put(block, 16 + 2 + deflated.size() + 8 - 1, 2);
+    block.append(deflated);
+    put(block, crc32(0, reinterpret_cast<Bytef const *>(data.data()), data.size()), 4);
+    put(block, data.size(), 4);
+    return block;
+}
+
+TEST(SequenceReader, Compressed)
+{
+    std::string const fasta = read_file(data("genome.fa"));
+    Sequences const expected = read_seqan3(data("genome.fa"));
+    std::filesystem::path const filepath = data("sequences.fa.gz");
+
+    // several gzip members
+    write_file(filepath, deflate_member(fasta.substr(0, 100), false) + deflate_member(fasta.substr(100), false));
+    Sequences result = read_parallel(filepath);
+    EXPECT_EQ(result.names, expected.names);
+    EXPECT_EQ(result.seqs, expected.seqs);
+
+    // BGZF blocks that split a sequence, followed by the empty end-of-file block
+    write_file(filepath, deflate_member(fasta.substr(0, 50), true) + deflate_member(fasta.substr(50, 70), true) +
+                         deflate_member(fasta.substr(120), true) + deflate_member("", true));
+    result = read_parallel(filepath);
+    EXPECT_EQ(result.names, expected.names);
+    EXPECT_EQ(result.seqs, expected.seqs);
+
+    // a truncated file is detected
+    std::string const content = deflate_member(fasta, false);
+    write_file(filepath, content.substr(0, content.size() / 2));
+    mars::PackedText text{};
+    std::vector<std::string> names{};
+    EXPECT_THROW(mars::read_sequences_parallel(filepath, text, names), seqan3::parse_error);
+    std::filesystem::remove(filepath);
+}
+#endif
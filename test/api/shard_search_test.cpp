@@ -0,0 +1,51 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+
+#include <seqan3/io/exception.hpp>
+
+#include "shard_search.hpp"
+
+TEST(ShardSearch, HitStream)
+{
+    mars::ShardResult result{};
+    result.names = {"chr1", "", "chr3 with a long name"};
+    result.text_length = 123456789012ull;
+    result.stats.resize(2);
+    result.stats[0].nodes = 300;
+    result.stats[1].hits = 4;
+    result.stats[1].seconds = 0.25;
+    result.hits.resize(3);
+    result.hits[0] = {{1000000000ll, 25, 1, 12.5f}, {17, 30, 0, -1.5f}};
+    result.hits[2] = {{0, 1, 1, 3.f}, {0, 2, 0, 4.f}};
+
+    std::string const stream = mars::encode_shard_result(result);
+    mars::ShardResult const decoded = mars::decode_shard_result(stream);
+    EXPECT_EQ(decoded.names, result.names);
+    EXPECT_EQ(decoded.text_length, result.text_length);
+    ASSERT_EQ(decoded.stats.size(), 2u);
+    EXPECT_EQ(decoded.stats[0].nodes, 300u);
+    EXPECT_EQ(decoded.stats[1].hits, 4u);
+    EXPECT_EQ(decoded.stats[1].seconds, 0.25);
+    ASSERT_EQ(decoded.hits.size(), 3u);
+    EXPECT_TRUE(decoded.hits[1].empty());
+
+    // the hits are sorted by position
+    ASSERT_EQ(decoded.hits[0].size(), 2u);
+    EXPECT_EQ(decoded.hits[0][0].pos, 17);
+    EXPECT_EQ(decoded.hits[0][0].length, 30);
+    EXPECT_EQ(decoded.hits[0][0].midx, 0u);
+    EXPECT_EQ(decoded.hits[0][0].score, -1.5f);
+    EXPECT_EQ(decoded.hits[0][1].pos, 1000000000);
+    ASSERT_EQ(decoded.hits[2].size(), 2u);
+    EXPECT_EQ(decoded.hits[2][1].pos, 0);
+
+    // a truncated stream is detected
+    EXPECT_THROW(mars::decode_shard_result(stream.substr(0, stream.size() - 3)), seqan3::parse_error);
+    EXPECT_THROW(mars::decode_shard_result("MARS"), seqan3::parse_error);
+}
@@ -0,0 +1,351 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <seqan3/std/filesystem>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <seqan3/alphabet/gap/gapped.hpp>
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+#include <seqan3/alphabet/nucleotide/rna15.hpp>
+#include <seqan3/alphabet/nucleotide/rna4.hpp>
+
+#if SEQAN3_WITH_CEREAL
+#include <cereal/archives/binary.hpp>
+#endif
+
+#include "bi_alphabet.hpp"
+#include "index.hpp"
+#include "location.hpp"
+#include "motif.hpp"
+#include "multiple_alignment.hpp"
+#include "profile_char.hpp"
+#include "search.hpp"
+#include "settings.hpp"
+
+// Generate the full path of a test input file that is provided in the data directory.
+std::filesystem::path data(std::string const & filename)
+{
+    return std::filesystem::path{std::string{DATADIR}}.concat(filename);
+}
+
+// The input data shared by all benchmarks, which is loaded on first access.
+struct BenchmarkData
+{
+    mars::Msa msa;
+    mars::MsaColumns columns;
+    mars::Motif motif;
+    std::vector<std::string> names;
+    mars::Index index;
+
+    BenchmarkData() :
+        msa{mars::read_msa(data("SSU_rRNA_5.sth"))},
+        columns{msa},
+        motif{mars::detect_stemloops(msa.structure.first, msa.structure.second)}
+    {
+        for (mars::Stemloop & stemloop : motif)
+            stemloop.analyze(msa, columns);
+
+        // The ungapped alignment rows serve as the genome.
+        std::vector<seqan3::dna4_vector> genome{};
+        for (size_t row = 0; row < msa.sequences.size(); ++row)
+        {
+            genome.emplace_back();
+            for (auto chr : msa.sequences[row])
+                if (chr != seqan3::gap())
+                    genome.back().push_back(seqan3::dna4{}.assign_char(chr.to_char()));
+            names.push_back(msa.names[row]);
+        }
+        index = mars::Index{genome};
+    }
+
+    static BenchmarkData const & get()
+    {
+        static BenchmarkData const instance{};
+        return instance;
+    }
+};
+
+// Make sure that a thread pool exists and the console stays quiet.
+void setup_settings()
+{
+    mars::settings.verbose = 0u;
+    if (!mars::pool)
+        mars::pool = std::make_unique<thread_pool::ThreadPool>(1u);
+}
+
+// Count the characters of all alignment columns, including wildcards and gaps.
+static void profile_increment(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    size_t const width = input.msa.sequences.front().size();
+    for (auto _ : state)
+    {
+        for (size_t col = 0; col < width; ++col)
+        {
+            mars::profile_char<seqan3::rna4> prof{};
+            seqan3::gapped<seqan3::rna15> const * column = input.columns.column(col);
+            for (size_t row = 0; row < input.columns.rows(); ++row)
+                prof.increment(column[row]);
+            benchmark::DoNotOptimize(prof);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * width * input.columns.rows());
+}
+BENCHMARK(profile_increment);
+
+// Count the base pairs of column pairs, including wildcards and gaps.
+static void profile_increment_pair(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    size_t const width = input.msa.sequences.front().size();
+    for (auto _ : state)
+    {
+        for (size_t col = 0; col + 1 < width; col += 2)
+        {
+            mars::profile_char<mars::bi_alphabet<seqan3::gapped<seqan3::rna4>>> prof{};
+            seqan3::gapped<seqan3::rna15> const * left = input.columns.column(col);
+            seqan3::gapped<seqan3::rna15> const * right = input.columns.column(col + 1);
+            for (size_t row = 0; row < input.columns.rows(); ++row)
+                prof.increment(left[row], right[row]);
+            benchmark::DoNotOptimize(prof);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (width / 2) * input.columns.rows());
+}
+BENCHMARK(profile_increment_pair);
+
+// Compute the score-sorted options of a base pair profile.
+static void profile_priority(benchmark::State & state)
+{
+    using alphabet_type = mars::bi_alphabet<seqan3::gapped<seqan3::rna4>>;
+    using rank_type = seqan3::alphabet_rank_t<alphabet_type>;
+    std::mt19937 rng{42};
+    size_t constexpr sigma = seqan3::alphabet_size<alphabet_type>;
+    mars::profile_char<alphabet_type> prof{};
+    for (size_t rnk = 0; rnk < sigma; ++rnk) // every pair is present
+        prof.increment(static_cast<rank_type>(rnk));
+    for (size_t idx = 0; idx < 200; ++idx)
+        prof.increment(static_cast<rank_type>(rng() % sigma));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mars::priority(prof, 225));
+}
+BENCHMARK(profile_priority);
+
+// Analyze all stemloops of the alignment, i.e. build their profiles.
+static void stemloop_analyze(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    for (auto _ : state)
+    {
+        for (mars::Stemloop const & proto : input.motif)
+        {
+            mars::Stemloop stemloop{proto.uid, proto.bounds};
+            stemloop.analyze(input.msa, input.columns);
+            benchmark::DoNotOptimize(stemloop.elements.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * input.motif.size());
+}
+BENCHMARK(stemloop_analyze);
+
+// Extend the query by the best option of each step of the first stemloop and backtrack afterwards.
+static void search_append(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    mars::Stemloop const & stemloop = input.motif.front();
+    mars::SearchProgram const program{stemloop};
+    mars::StemloopHitStore hits{input.names.size()};
+    mars::ConcurrentFutureVector queries{};
+    mars::SearchInfo info{input.index, stemloop, hits, queries};
+
+    size_t count = 0;
+    for (auto _ : state)
+    {
+        uint32_t step = 0;
+        for (; step < program.size() && info.append(program.option(program.step(step).options_begin)); ++step)
+            ++count;
+        for (; step > 0; --step)
+            info.backtrack();
+    }
+    state.SetItemsProcessed(count);
+}
+BENCHMARK(search_append);
+
+// Extend a cursor with random characters in alternating direction until the query is not found.
+static void cursor_extend(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    std::mt19937 rng{42};
+    size_t count = 0;
+    for (auto _ : state)
+    {
+        auto cursor = input.index.cursor();
+        bool found = true;
+        for (bool left = true; found; left = !left, ++count)
+        {
+            seqan3::dna4 const chr = seqan3::dna4{}.assign_rank(rng() % 4);
+            found = left ? cursor.extend_left(chr) : cursor.extend_right(chr);
+        }
+        benchmark::DoNotOptimize(cursor);
+    }
+    state.SetItemsProcessed(count);
+}
+BENCHMARK(cursor_extend);
+
+// Locate all occurrences of random k-mers, where k is the benchmark argument.
+static void cursor_locate(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    std::mt19937 rng{42};
+    size_t count = 0;
+    for (auto _ : state)
+    {
+        auto cursor = input.index.cursor();
+        for (long len = 0; len < state.range(0); ++len)
+            if (!cursor.extend_right(seqan3::dna4{}.assign_rank(rng() % 4)))
+                break;
+        auto const occurrences = cursor.locate();
+        count += occurrences.size();
+        benchmark::DoNotOptimize(occurrences.data());
+    }
+    state.SetItemsProcessed(count);
+}
+BENCHMARK(cursor_locate)->Arg(6)->Arg(8)->Arg(12);
+
+// Search the hits of the best options of the first stemloop, including the asynchronous location.
+static void search_compute_hits(benchmark::State & state)
+{
+    setup_settings();
+    BenchmarkData const & input = BenchmarkData::get();
+    mars::Stemloop stemloop{0, {0, 0}};
+    mars::SearchProgram const program{input.motif.front()};
+    mars::StemloopHitStore hits{input.names.size()};
+    mars::ConcurrentFutureVector queries{};
+    mars::SearchInfo info{input.index, stemloop, hits, queries};
+
+    // Extend the query with positive options until it has a length of at least 6.
+    for (uint32_t step = 0; step < program.size() && step < 4; ++step)
+        info.append({1.f, program.option(program.step(step).options_begin).left,
+                     program.option(program.step(step).options_begin).right});
+
+    for (auto _ : state)
+    {
+        info.compute_hits();
+        for (auto & future : queries.futures)
+            future.wait();
+        queries.futures.clear();
+    }
+}
+BENCHMARK(search_compute_hits);
+
+// Merge random stemloop hits into motif locations.
+static void search_merge_hits(benchmark::State & state)
+{
+    setup_settings();
+    BenchmarkData const & input = BenchmarkData::get();
+    std::mt19937 rng{42};
+    size_t const hits_per_sequence = static_cast<size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        mars::StemloopHitStore hits{input.names.size()};
+        for (size_t seq = 0; seq < input.names.size(); ++seq)
+            for (size_t idx = 0; idx < hits_per_sequence; ++idx)
+                hits.push({static_cast<long long>(rng() % 1500),
+                           30,
+                           static_cast<uint8_t>(rng() % input.motif.size()),
+                           static_cast<float>(rng() % 20)}, seq);
+        mars::MotifLocationStore locations{input.names};
+        state.ResumeTiming();
+
+        mars::merge_hits(locations, hits, input.motif, 1000000ul, 0ul, input.names.size());
+        benchmark::DoNotOptimize(locations.data());
+    }
+    state.SetItemsProcessed(state.iterations() * hits_per_sequence * input.names.size());
+}
+BENCHMARK(search_merge_hits)->Arg(16)->Arg(256);
+
+// Sort and print motif locations to a file.
+static void location_print(benchmark::State & state)
+{
+    setup_settings();
+    BenchmarkData const & input = BenchmarkData::get();
+    mars::settings.result_file = std::filesystem::path{std::string{OUTPUTDIR}}.concat("benchmark_locations.txt");
+    mars::settings.score_filter = 0.f; // print all locations
+    std::mt19937 rng{42};
+    mars::MotifLocationStore locations{input.names};
+    for (long idx = 0; idx < state.range(0); ++idx)
+    {
+        float const score = static_cast<float>(rng() % 1000) / 10.f;
+        size_t const pos = rng() % 100000;
+        locations.push({1e6 / exp2(score), score, 3, pos, pos + 120, 100, rng() % input.names.size()});
+    }
+
+    for (auto _ : state)
+        locations.print();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove(mars::settings.result_file);
+    mars::settings.result_file.clear();
+}
+BENCHMARK(location_print)->Arg(1000)->Arg(100000);
+
+#if SEQAN3_WITH_CEREAL
+// Serialize the index into memory.
+static void index_serialize(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    size_t bytes = 0;
+    for (auto _ : state)
+    {
+        std::ostringstream stream{};
+        {
+            cereal::BinaryOutputArchive oarchive{stream};
+            oarchive(input.index);
+            oarchive(input.names);
+        }
+        bytes += stream.tellp();
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(index_serialize);
+
+// Deserialize the index from memory.
+static void index_deserialize(benchmark::State & state)
+{
+    BenchmarkData const & input = BenchmarkData::get();
+    std::ostringstream ostream{};
+    {
+        cereal::BinaryOutputArchive oarchive{ostream};
+        oarchive(input.index);
+        oarchive(input.names);
+    }
+    std::string const buffer = ostream.str();
+
+    for (auto _ : state)
+    {
+        std::istringstream stream{buffer};
+        cereal::BinaryInputArchive iarchive{stream};
+        mars::Index index{};
+        std::vector<std::string> names{};
+        iarchive(index);
+        iarchive(names);
+        benchmark::DoNotOptimize(index);
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(index_deserialize);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,506 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+// This program generates a synthetic genome with planted instances of an RNA family, runs the MaRs executable
+// on a grid of performance parameters and writes a JSON report with the run times, memory and recall.
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <seqan3/std/filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <seqan3/argument_parser/all.hpp>
+
+#include "format_clustal.hpp"
+#include "format_stockholm.hpp"
+#include "multiple_alignment.hpp"
+
+//! \brief The options of the benchmark harness.
+struct HarnessSettings
+{
+    std::filesystem::path alignment_file{};
+    std::filesystem::path mars_binary{std::string{BINDIR} + "mars"};
+    std::filesystem::path work_dir{std::string{OUTPUTDIR}};
+    std::filesystem::path report_file{};
+    size_t genome_length{10000000ul};
+    size_t sequence_count{1ul};
+    double gc_content{0.5};
+    size_t planted_count{100ul};
+    unsigned int seed{42u};
+    unsigned int repetitions{1u};
+    std::vector<unsigned int> threads{};
+    std::vector<unsigned int> prune{};
+    std::vector<unsigned int> xdrop{};
+};
+
+//! \brief The location of a planted family member in the genome.
+struct PlantedInstance
+{
+    size_t sequence; //!< The sequence index.
+    size_t begin; //!< The start position within the sequence.
+    size_t end; //!< One after the end position within the sequence.
+};
+
+//! \brief A location that MaRs has reported.
+struct ReportedLocation
+{
+    size_t sequence; //!< The sequence index.
+    size_t begin; //!< The start position within the sequence.
+    size_t end; //!< The end position within the sequence.
+};
+
+//! \brief The measurements of a single MaRs run.
+struct RunResult
+{
+    int exit_code{-1}; //!< The exit code of the MaRs process.
+    double wall_time{0}; //!< The elapsed time in seconds.
+    double cpu_time{0}; //!< The user and system time in seconds.
+    long peak_rss_kb{0}; //!< The maximum resident set size in kilobytes.
+    std::vector<std::pair<std::string, std::optional<double>>> phases{}; //!< The wall time of each phase.
+    std::vector<ReportedLocation> locations{}; //!< The reported locations.
+};
+
+bool parse_arguments(HarnessSettings & settings, int argc, char ** argv)
+{
+    seqan3::argument_parser parser{"mars_macrobenchmark", argc, argv, seqan3::update_notifications::off};
+    parser.info.short_description = "End-to-end benchmark of MaRs on synthetic genomes";
+    parser.info.description.emplace_back("Generates a random genome with planted instances of the given RNA family, "
+                                         "runs MaRs for every combination of the given thread counts, prune and "
+                                         "xdrop values, and reports the wall time of each phase, the peak memory, "
+                                         "the throughput and the recall of the planted instances in JSON format.");
+    parser.info.synopsis.emplace_back("./mars_macrobenchmark -a tRNA.aln -n 100000000 -j 1 -j 8 -o report.json");
+
+    parser.add_subsection("Input data:");
+    parser.add_option(settings.alignment_file, 'a', "alignment",
+                      "Alignment file of the RNA family that is planted into the genome.",
+                      seqan3::option_spec::required,
+                      seqan3::input_file_validator{{"msa", "aln", "sth", "stk", "sto"}});
+    parser.add_option(settings.mars_binary, 'b', "binary", "The MaRs executable.");
+    parser.add_option(settings.work_dir, 'w', "workdir", "Directory for the genome, index and result files.");
+    parser.add_option(settings.report_file, 'o', "output",
+                      "The output file for the JSON report. If empty we print to stdout.");
+
+    parser.add_subsection("Genome options:");
+    parser.add_option(settings.genome_length, 'n', "length", "The total length of the genome.");
+    parser.add_option(settings.sequence_count, 'c', "sequences", "The number of genome sequences.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1000000});
+    parser.add_option(settings.gc_content, 'g', "gc", "The GC content of the background sequence.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0, 1});
+    parser.add_option(settings.planted_count, 'i', "instances", "The number of planted family members.");
+    parser.add_option(settings.seed, 's', "seed", "The seed for the random number generator.");
+
+    parser.add_subsection("Benchmark grid:");
+    parser.add_option(settings.threads, 'j', "threads", "A thread count for MaRs. Repeat for multiple values.");
+    parser.add_option(settings.prune, 'p', "prune", "A prune value for MaRs. Repeat for multiple values.");
+    parser.add_option(settings.xdrop, 'x', "xdrop", "An xdrop value for MaRs. Repeat for multiple values.");
+    parser.add_option(settings.repetitions, 'r', "repetitions", "The number of runs per parameter combination.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1000});
+
+    try
+    {
+        parser.parse();
+    }
+    catch (seqan3::argument_parser_error const & ext)
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n";
+        return false;
+    }
+
+    // Use the defaults of MaRs if no grid values are given.
+    if (settings.threads.empty())
+        settings.threads.push_back(std::max(1u, std::thread::hardware_concurrency()));
+    if (settings.prune.empty())
+        settings.prune.push_back(10u);
+    if (settings.xdrop.empty())
+        settings.xdrop.push_back(4u);
+    return true;
+}
+
+/*!
+ * \brief Read the ungapped family members from an alignment file.
+ * \param filepath The alignment file.
+ * \return The sequences as DNA strings, where wildcards are kept as 'N'.
+ */
+std::vector<std::string> read_family(std::filesystem::path const & filepath)
+{
+    mars::Msa msa{};
+    if (filepath.extension() == ".aln" || filepath.extension() == ".msa")
+        msa = mars::read_clustal_file<mars::Msa::Alphabet>(filepath);
+    else
+        msa = mars::read_stockholm_file<mars::Msa::Alphabet>(filepath);
+
+    std::vector<std::string> family{};
+    for (auto const & row : msa.sequences)
+    {
+        std::string & member = family.emplace_back();
+        for (auto chr : row)
+        {
+            if (chr == seqan3::gap())
+                continue;
+            char const dna = chr.to_char() == 'U' ? 'T' : chr.to_char();
+            member.push_back(std::string_view{"ACGT"}.find(dna) == std::string_view::npos ? 'N' : dna);
+        }
+    }
+    return family;
+}
+
+/*!
+ * \brief Generate random sequences and plant family members at non-overlapping positions.
+ * \param[in] settings The harness settings.
+ * \param[in] family The family members to choose from.
+ * \param[out] planted The locations of the planted members.
+ * \return The genome sequences.
+ */
+std::vector<std::string> generate_genome(HarnessSettings const & settings,
+                                         std::vector<std::string> const & family,
+                                         std::vector<PlantedInstance> & planted)
+{
+    std::mt19937_64 rng{settings.seed};
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    auto random_base = [&rng, &unit, gc = settings.gc_content] ()
+    {
+        bool const strong = unit(rng) < gc;
+        bool const second = unit(rng) < 0.5;
+        return strong ? (second ? 'G' : 'C') : (second ? 'T' : 'A');
+    };
+
+    std::vector<std::string> genome(settings.sequence_count);
+    size_t const length = std::max<size_t>(1ul, settings.genome_length / settings.sequence_count);
+    for (std::string & seq : genome)
+    {
+        seq.resize(length);
+        std::generate(seq.begin(), seq.end(), random_base);
+    }
+
+    // Choose random members and positions; give up on a member after several overlapping attempts.
+    std::vector<std::vector<PlantedInstance>> occupied(genome.size());
+    auto before = [] (PlantedInstance const & lhs, PlantedInstance const & rhs)
+    {
+        return lhs.end <= rhs.begin;
+    };
+    for (size_t count = 0; count < settings.planted_count; ++count)
+    {
+        std::string const & member = family[rng() % family.size()];
+        if (member.size() >= length)
+            continue;
+
+        for (int attempt = 0; attempt < 100; ++attempt)
+        {
+            size_t const sequence = rng() % genome.size();
+            size_t const begin = rng() % (length - member.size());
+            PlantedInstance const instance{sequence, begin, begin + member.size()};
+            auto & taken = occupied[sequence];
+            auto const iter = std::lower_bound(taken.begin(), taken.end(), instance, before);
+            if (iter != taken.end() && iter->begin < instance.end)
+                continue;
+
+            taken.insert(iter, instance);
+            planted.push_back(instance);
+            for (size_t idx = 0; idx < member.size(); ++idx)
+                genome[sequence][begin + idx] = member[idx] == 'N' ? random_base() : member[idx];
+            break;
+        }
+    }
+    return genome;
+}
+
+/*!
+ * \brief Write the genome in FASTA format.
+ * \param filepath The output file.
+ * \param genome The genome sequences.
+ */
+void write_fasta(std::filesystem::path const & filepath, std::vector<std::string> const & genome)
+{
+    std::ofstream ofs{filepath};
+    if (!ofs)
+        throw std::runtime_error{"Could not write the genome file " + filepath.string()};
+
+    for (size_t idx = 0; idx < genome.size(); ++idx)
+    {
+        ofs << ">synthetic_" << idx << '\n';
+        for (size_t pos = 0; pos < genome[idx].size(); pos += 80)
+            ofs << std::string_view{genome[idx]}.substr(pos, 80) << '\n';
+    }
+}
+
+/*!
+ * \brief Write the planted instances in BED format, which serves as truth file for `mars_sensitivity`.
+ * \param filepath The output file.
+ * \param planted The planted instances.
+ */
+void write_bed(std::filesystem::path const & filepath, std::vector<PlantedInstance> const & planted)
+{
+    std::ofstream ofs{filepath};
+    if (!ofs)
+        throw std::runtime_error{"Could not write the truth file " + filepath.string()};
+
+    for (PlantedInstance const & inst : planted)
+        ofs << "synthetic_" << inst.sequence << '\t' << inst.begin << '\t' << inst.end << '\n';
+}
+
+/*!
+ * \brief Read the locations from a MaRs result file.
+ * \param filepath The result file.
+ * \return The reported locations.
+ */
+std::vector<ReportedLocation> read_results(std::filesystem::path const & filepath)
+{
+    std::vector<ReportedLocation> locations{};
+    std::ifstream ifs{filepath};
+    std::string line{};
+    std::getline(ifs, line); // skip the header
+    while (std::getline(ifs, line))
+    {
+        std::istringstream fields{line.substr(std::min(line.find('\t'), line.size()))};
+        ReportedLocation loc{};
+        if (fields >> loc.sequence >> loc.begin >> loc.end)
+            locations.push_back(loc);
+    }
+    return locations;
+}
+
+/*!
+ * \brief Read the wall time of the phases from the JSON phase report of MaRs (option -R).
+ * \param filepath The report file.
+ * \return The name and wall time of each recorded phase in the order of completion.
+ */
+std::vector<std::pair<std::string, double>> read_phase_report(std::filesystem::path const & filepath)
+{
+    // The report lists one phase per line: {"name": "search", "wall_time": 1.5, ...}
+    std::vector<std::pair<std::string, double>> phases{};
+    std::ifstream ifs{filepath};
+    std::string line{};
+    std::string_view const name_key{"{\"name\": \""};
+    std::string_view const wall_key{"\"wall_time\": "};
+    while (std::getline(ifs, line))
+    {
+        size_t const name_pos = line.find(name_key);
+        size_t const wall_pos = line.find(wall_key);
+        if (name_pos == std::string::npos || wall_pos == std::string::npos)
+            continue;
+        size_t const name_begin = name_pos + name_key.size();
+        size_t const name_end = line.find('"', name_begin);
+        if (name_end == std::string::npos)
+            continue;
+        std::istringstream wall{line.substr(wall_pos + wall_key.size())};
+        double seconds{};
+        if (wall >> seconds)
+            phases.emplace_back(line.substr(name_begin, name_end - name_begin), seconds);
+    }
+    return phases;
+}
+
+/*!
+ * \brief Run MaRs and measure the time of each phase, which is taken from its phase report.
+ * \param arguments The command line of MaRs, starting with the executable.
+ * \param report_file The phase report that MaRs writes, which is given with the -R option.
+ * \return The measurements of the run.
+ */
+RunResult run_mars(std::vector<std::string> const & arguments, std::filesystem::path const & report_file)
+{
+    std::filesystem::remove(report_file);
+    std::vector<std::string> command{arguments};
+    command.insert(command.end(), {"-R", report_file.string()});
+
+    auto const tm0 = std::chrono::steady_clock::now();
+    pid_t const pid = fork();
+    if (pid < 0)
+        throw std::runtime_error{"Could not start a process."};
+
+    if (pid == 0) // the MaRs process
+    {
+        std::vector<char *> argv{};
+        for (std::string const & arg : command)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    RunResult result{};
+    int status{};
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    result.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - tm0).count();
+    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    result.cpu_time = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    result.peak_rss_kb = usage.ru_maxrss;
+
+    // Sum the reported phases into the stages of the benchmark; a stage without any phase remains null.
+    std::vector<std::pair<std::string, std::vector<std::string_view>>> const stages
+    {
+        {"motif", {"alignment parse", "structure prediction", "motif analysis", "calibration"}},
+        {"index", {"genome read", "index build", "index load", "index write", "index replicate"}},
+        {"search", {"search"}},
+        {"locate", {"locate"}},
+        {"merge", {"merge"}},
+        {"output", {"output"}}
+    };
+    std::vector<std::pair<std::string, double>> const phases = read_phase_report(report_file);
+    for (auto const & [stage, names] : stages)
+    {
+        std::optional<double> seconds{};
+        for (auto const & [name, wall] : phases)
+            if (std::find(names.begin(), names.end(), name) != names.end())
+                seconds = seconds.value_or(0.0) + wall;
+        result.phases.emplace_back(stage, seconds);
+    }
+    return result;
+}
+
+/*!
+ * \brief Count the planted instances that overlap a reported location.
+ * \param planted The planted instances.
+ * \param locations The reported locations.
+ * \return The number of found instances and the number of locations that overlap an instance.
+ */
+std::pair<size_t, size_t> evaluate(std::vector<PlantedInstance> const & planted,
+                                   std::vector<ReportedLocation> const & locations)
+{
+    auto overlap = [] (PlantedInstance const & inst, ReportedLocation const & loc)
+    {
+        return inst.sequence == loc.sequence && inst.begin <= loc.end && loc.begin < inst.end;
+    };
+
+    size_t found{0};
+    for (PlantedInstance const & inst : planted)
+        found += std::any_of(locations.begin(), locations.end(), [&] (auto const & loc) { return overlap(inst, loc); });
+
+    size_t correct{0};
+    for (ReportedLocation const & loc : locations)
+        correct += std::any_of(planted.begin(), planted.end(), [&] (auto const & inst) { return overlap(inst, loc); });
+
+    return {found, correct};
+}
+
+// Print a value in JSON format, where missing values are null.
+std::ostream & json_value(std::ostream & os, std::optional<double> value)
+{
+    if (value)
+        os << *value;
+    else
+        os << "null";
+    return os;
+}
+
+int main(int argc, char ** argv)
+{
+    HarnessSettings settings{};
+    if (!parse_arguments(settings, argc, argv))
+        return EXIT_FAILURE;
+
+    // Generate the genome with planted family members.
+    std::vector<std::string> const family = read_family(settings.alignment_file);
+    if (family.empty())
+    {
+        std::cerr << "The alignment " << settings.alignment_file << " contains no sequences.\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<PlantedInstance> planted{};
+    std::vector<std::string> const genome = generate_genome(settings, family, planted);
+    size_t total_length{0};
+    for (std::string const & seq : genome)
+        total_length += seq.size();
+
+    std::filesystem::create_directories(settings.work_dir);
+    std::filesystem::path const genome_file = settings.work_dir / "synthetic_genome.fa";
+    std::filesystem::path const result_file = settings.work_dir / "synthetic_result.txt";
+    std::filesystem::path const phase_file = settings.work_dir / "synthetic_phases.json";
+    write_fasta(genome_file, genome);
+    write_bed(std::filesystem::path{genome_file}.replace_extension(".bed"), planted);
+    std::cerr << "Generated " << genome.size() << " sequences of total length " << total_length << " with "
+              << planted.size() << " planted instances ==> " << genome_file << std::endl;
+
+    std::ostringstream report{};
+    report << std::setprecision(6) << "{\n"
+           << "  \"alignment\": \"" << settings.alignment_file.filename().string() << "\",\n"
+           << "  \"genome\": {\"length\": " << total_length << ", \"sequences\": " << genome.size()
+           << ", \"gc_content\": " << settings.gc_content << ", \"planted\": " << planted.size()
+           << ", \"seed\": " << settings.seed << "},\n"
+           << "  \"runs\": [";
+
+    // The parameter grid: threads, prune, xdrop and repetition.
+    std::vector<std::tuple<unsigned int, unsigned int, unsigned int, unsigned int>> grid{};
+    for (unsigned int threads : settings.threads)
+        for (unsigned int prune : settings.prune)
+            for (unsigned int xdrop : settings.xdrop)
+                for (unsigned int repetition = 0; repetition < settings.repetitions; ++repetition)
+                    grid.emplace_back(threads, prune, xdrop, repetition);
+
+    for (size_t run = 0; run < grid.size(); ++run)
+    {
+        auto const [threads, prune, xdrop, repetition] = grid[run];
+
+        // Remove a previous index, such that each run includes the index construction.
+        for (char const * suffix : {".marsindex", ".marsindex.gz"})
+            std::filesystem::remove(std::filesystem::path{genome_file}.concat(suffix));
+        std::filesystem::remove(result_file);
+
+        std::cerr << "Running MaRs with " << threads << " threads, prune " << prune << ", xdrop " << xdrop
+                  << " (" << (run + 1) << "/" << grid.size() << ")..." << std::flush;
+        RunResult result = run_mars({settings.mars_binary.string(), "-a", settings.alignment_file.string(),
+                                     "-g", genome_file.string(), "-o", result_file.string(), "-v", "0",
+                                     "-j", std::to_string(threads), "-p", std::to_string(prune),
+                                     "-x", std::to_string(xdrop)},
+                                    phase_file);
+        result.locations = read_results(result_file);
+        auto const [found, correct] = evaluate(planted, result.locations);
+        std::cerr << " " << result.wall_time << "s" << std::endl;
+
+        std::optional<double> const search_time = result.phases[2].second;
+        std::optional<double> const search_throughput = search_time && *search_time > 0
+                                                      ? std::optional<double>{total_length / 1e6 / *search_time}
+                                                      : std::nullopt;
+
+        report << (run == 0 ? "\n" : ",\n")
+               << "    {\"threads\": " << threads << ", \"prune\": " << prune << ", \"xdrop\": " << xdrop
+               << ", \"repetition\": " << repetition << ", \"exit_code\": " << result.exit_code << ",\n"
+               << "     \"wall_time\": " << result.wall_time << ", \"cpu_time\": " << result.cpu_time
+               << ", \"peak_rss_kb\": " << result.peak_rss_kb << ",\n"
+               << "     \"phases\": {";
+        for (size_t idx = 0; idx < result.phases.size(); ++idx)
+            json_value(report << (idx ? ", " : "") << "\"" << result.phases[idx].first << "\": ",
+                       result.phases[idx].second);
+        report << "},\n"
+               << "     \"throughput_mbp_per_s\": " << total_length / 1e6 / result.wall_time
+               << ", \"search_throughput_mbp_per_s\": ";
+        json_value(report, search_throughput);
+        report << ",\n"
+               << "     \"locations\": " << result.locations.size()
+               << ", \"recall\": " << (planted.empty() ? 0.0 : 1.0 * found / planted.size())
+               << ", \"precision\": " << (result.locations.empty() ? 0.0 : 1.0 * correct / result.locations.size())
+               << "}";
+    }
+    report << "\n  ]\n}\n";
+
+    if (settings.report_file.empty())
+    {
+        std::cout << report.str();
+    }
+    else
+    {
+        std::ofstream ofs{settings.report_file};
+        ofs << report.str();
+        std::cerr << "Written the report ==> " << settings.report_file << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+// ------------------------------------------------------------------------------------------------------------
+// This is MaRs, Motif-based aligned RNA searcher.
+// Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+// This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+// shipped with this file and also available at https://github.com/seqan/mars.
+// ------------------------------------------------------------------------------------------------------------
+
+// This program measures the tradeoff between sensitivity and speed of the search: for a grid of prune and xdrop
+// values it searches a labeled genome and reports the recall of the known locations, the search time and the
+// number of visited nodes in the search trees.
+
+#include <algorithm>
+#include <chrono>
+#include <seqan3/std/filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <seqan3/argument_parser/all.hpp>
+
+#include "index.hpp"
+#include "location.hpp"
+#include "motif.hpp"
+#include "multiple_alignment.hpp"
+#include "search.hpp"
+#include "settings.hpp"
+#include "thread_budget.hpp"
+
+//! \brief The options of the sensitivity benchmark.
+struct SensitivitySettings
+{
+    std::filesystem::path alignment_file{};
+    std::filesystem::path genome_file{};
+    std::filesystem::path truth_file{};
+    std::filesystem::path report_file{};
+    std::vector<unsigned int> prune{};
+    std::vector<unsigned int> xdrop{};
+    unsigned int nthreads{std::max(1u, std::thread::hardware_concurrency())};
+};
+
+//! \brief A known location of a family member in the genome.
+struct KnownLocation
+{
+    size_t sequence; //!< The sequence index.
+    size_t begin; //!< The start position within the sequence.
+    size_t end; //!< One after the end position within the sequence.
+};
+
+bool parse_arguments(SensitivitySettings & settings, int argc, char ** argv)
+{
+    seqan3::argument_parser parser{"mars_sensitivity", argc, argv, seqan3::update_notifications::off};
+    parser.info.short_description = "Sensitivity versus throughput of the MaRs search";
+    parser.info.description.emplace_back("Creates the motif for every given prune value and searches it with every "
+                                         "given xdrop value in the genome. For each setting we report the search "
+                                         "time, the number of visited search tree nodes, and the recall and "
+                                         "precision of the reported locations with respect to the known locations.");
+    parser.info.synopsis.emplace_back("./mars_sensitivity -a tRNA.aln -g genome.fa -t genome.bed -p 5 -p 10 -x 2 -x 4");
+
+    parser.add_subsection("Input data:");
+    parser.add_option(settings.alignment_file, 'a', "alignment",
+                      "Alignment file of structurally aligned RNA sequences.",
+                      seqan3::option_spec::required,
+                      seqan3::input_file_validator{{"msa", "aln", "sth", "stk", "sto"}});
+    parser.add_option(settings.genome_file, 'g', "genome",
+                      "A sequence file containing one or more sequences.",
+                      seqan3::option_spec::required);
+    parser.add_option(settings.truth_file, 't', "truth",
+                      "A BED file with the known locations of the family (sequence name, start, end).",
+                      seqan3::option_spec::required,
+                      seqan3::input_file_validator{{"bed"}});
+    parser.add_option(settings.report_file, 'o', "output",
+                      "The output file for the JSON report. If empty we print to stdout.");
+
+    parser.add_subsection("Benchmark grid:");
+    parser.add_option(settings.prune, 'p', "prune", "A prune value. Repeat for multiple values.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0, 100});
+    parser.add_option(settings.xdrop, 'x', "xdrop", "An xdrop value. Repeat for multiple values.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0, 255});
+    parser.add_option(settings.nthreads, 'j', "threads", "Use the number of specified threads.");
+
+    try
+    {
+        parser.parse();
+    }
+    catch (seqan3::argument_parser_error const & ext)
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n";
+        return false;
+    }
+
+    // Use the defaults of MaRs if no grid values are given.
+    if (settings.prune.empty())
+        settings.prune.push_back(mars::settings.prune);
+    if (settings.xdrop.empty())
+        settings.xdrop.push_back(mars::settings.xdrop);
+    return true;
+}
+
+/*!
+ * \brief Read the known locations from a BED file.
+ * \param filepath The BED file.
+ * \param names The sequence names of the genome.
+ * \return The known locations, where locations on unknown sequences are skipped.
+ */
+std::vector<KnownLocation> read_truth(std::filesystem::path const & filepath, std::vector<std::string> const & names)
+{
+    std::unordered_map<std::string, size_t> sequence_ids{};
+    for (size_t idx = 0; idx < names.size(); ++idx)
+        sequence_ids.emplace(names[idx], idx);
+
+    std::vector<KnownLocation> truth{};
+    std::ifstream ifs{filepath};
+    std::string line{};
+    while (std::getline(ifs, line))
+    {
+        if (line.empty() || line[0] == '#' || line.rfind("track", 0) == 0 || line.rfind("browser", 0) == 0)
+            continue;
+
+        std::istringstream fields{line};
+        std::string name{};
+        KnownLocation loc{};
+        if (!(fields >> name >> loc.begin >> loc.end))
+            throw std::runtime_error{"Invalid line in the truth file: " + line};
+
+        auto const iter = sequence_ids.find(name);
+        if (iter == sequence_ids.end())
+        {
+            std::cerr << "Skipping a location on the unknown sequence " << name << ".\n";
+            continue;
+        }
+        loc.sequence = iter->second;
+        truth.push_back(loc);
+    }
+    return truth;
+}
+
+// The total number of positions and extension options of a motif, which reflects the effect of pruning.
+std::pair<size_t, size_t> motif_size(mars::Motif const & motif)
+{
+    size_t positions{0};
+    size_t options{0};
+    for (mars::Stemloop const & stemloop : motif)
+    {
+        for (auto const & element : stemloop.elements)
+        {
+            std::visit([&positions, &options] (auto const & elem)
+            {
+                positions += elem.prio.size();
+                for (auto const & prio : elem.prio)
+                    options += prio.size();
+            }, element);
+        }
+    }
+    return {positions, options};
+}
+
+int main(int argc, char ** argv)
+{
+    SensitivitySettings settings{};
+    if (!parse_arguments(settings, argc, argv))
+        return EXIT_FAILURE;
+
+    mars::settings.verbose = 0u;
+    mars::settings.nthreads = std::max(1u, settings.nthreads);
+    mars::settings.alignment_file = settings.alignment_file;
+    mars::settings.genome_file = settings.genome_file;
+    mars::pool = std::make_unique<thread_pool::ThreadPool>(mars::settings.nthreads);
+    mars::thread_budget.reset(mars::settings.nthreads);
+
+    // Prepare the index, the alignment and the known locations once for all settings.
+    mars::BiDirectionalIndex index{};
+    index.create();
+    mars::Msa const msa = mars::read_msa(settings.alignment_file, mars::settings.nthreads);
+    std::vector<KnownLocation> const truth = read_truth(settings.truth_file, index.get_names());
+    std::cerr << "Searching " << truth.size() << " known locations in " << index.get_names().size()
+              << " sequences." << std::endl;
+
+    std::ostringstream report{};
+    report << std::setprecision(6) << "{\n"
+           << "  \"alignment\": \"" << settings.alignment_file.filename().string() << "\",\n"
+           << "  \"genome\": \"" << settings.genome_file.filename().string() << "\",\n"
+           << "  \"known_locations\": " << truth.size() << ",\n"
+           << "  \"threads\": " << mars::settings.nthreads << ",\n"
+           << "  \"runs\": [";
+
+    bool first = true;
+    for (unsigned int prune : settings.prune)
+    {
+        mars::settings.prune = static_cast<unsigned char>(prune);
+        mars::Motif const motif = mars::create_motif(msa);
+        auto const [positions, options] = motif_size(motif);
+
+        for (unsigned int xdrop : settings.xdrop)
+        {
+            mars::settings.xdrop = static_cast<unsigned char>(xdrop);
+            mars::MotifLocationStore locations{index.get_names()};
+            auto const tm0 = std::chrono::steady_clock::now();
+            std::vector<mars::SearchStats> const stats = mars::search_motif(index, motif, locations);
+            double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tm0).count();
+            size_t nodes{0};
+            for (mars::SearchStats const & stat : stats)
+                nodes += stat.nodes;
+
+            // Evaluate the locations that MaRs would report.
+            std::sort(locations.begin(), locations.end());
+            auto const reported_end = locations.cbegin() + locations.reported_count();
+            auto overlap = [] (KnownLocation const & known, mars::MotifLocation const & loc)
+            {
+                return known.sequence == loc.sequence && known.begin <= loc.position_end &&
+                       loc.position_start < known.end;
+            };
+            size_t found{0};
+            for (KnownLocation const & known : truth)
+                found += std::any_of(locations.cbegin(), reported_end, [&] (auto const & loc)
+                {
+                    return overlap(known, loc);
+                });
+            size_t correct{0};
+            for (auto loc = locations.cbegin(); loc != reported_end; ++loc)
+                correct += std::any_of(truth.cbegin(), truth.cend(), [&] (auto const & known)
+                {
+                    return overlap(known, *loc);
+                });
+
+            size_t const reported = reported_end - locations.cbegin();
+            double const recall = truth.empty() ? 0.0 : 1.0 * found / truth.size();
+            double const precision = reported == 0 ? 0.0 : 1.0 * correct / reported;
+            std::cerr << "prune " << prune << ", xdrop " << xdrop << ": recall " << recall << ", "
+                      << seconds << "s, " << nodes << " nodes" << std::endl;
+
+            report << (first ? "\n" : ",\n")
+                   << "    {\"prune\": " << prune << ", \"xdrop\": " << xdrop
+                   << ", \"stemloops\": " << motif.size() << ", \"motif_positions\": " << positions
+                   << ", \"motif_options\": " << options << ",\n"
+                   << "     \"search_time\": " << seconds << ", \"tree_nodes\": " << nodes
+                   << ", \"all_locations\": " << locations.size() << ", \"reported_locations\": " << reported
+                   << ", \"recall\": " << recall << ", \"precision\": " << precision << "}";
+            first = false;
+        }
+    }
+    report << "\n  ]\n}\n";
+
+    if (settings.report_file.empty())
+    {
+        std::cout << report.str();
+    }
+    else
+    {
+        std::ofstream ofs{settings.report_file};
+        ofs << report.str();
+        std::cerr << "Written the report ==> " << settings.report_file << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+# ------------------------------------------------------------------------------------------------------------
+# This is MaRs, Motif-based aligned RNA searcher.
+# Copyright (c) 2020-2022 Jörg Winkler & Knut Reinert @ Freie Universität Berlin & MPI für molekulare Genetik.
+# This file may be used, modified and/or redistributed under the terms of the 3-clause BSD-License
+# shipped with this file and also available at https://github.com/seqan/mars.
+# ------------------------------------------------------------------------------------------------------------
+
+cmake_minimum_required (VERSION 3.8)
+
+# Set the project specific configuration settings to configure and build the benchmark target.
+set (gbenchmark_project_args ${APP_TEMPLATE_EXTERNAL_PROJECT_CMAKE_ARGS})
+
+# Force that libraries are installed to `lib/`, because GNUInstallDirs might install it into `lib64/`.
+list (APPEND gbenchmark_project_args "-DCMAKE_INSTALL_LIBDIR=${PROJECT_BINARY_DIR}/lib/")
+
+# We neither need the tests of Google Benchmark nor its dependency on Googletest.
+list (APPEND gbenchmark_project_args "-DBENCHMARK_ENABLE_TESTING=OFF")
+list (APPEND gbenchmark_project_args "-DBENCHMARK_ENABLE_GTEST_TESTS=OFF")
+
+# Register how to download Google Benchmark.
+include (ExternalProject)
+ExternalProject_Add (googlebenchmark
+                     GIT_REPOSITORY    "https://github.com/google/benchmark.git"
+                     GIT_TAG           "v1.6.1"
+                     GIT_SHALLOW
+                     GIT_CONFIG        "advice.detachedHead=false"
+                     LOG_CONFIGURE     1
+                     PREFIX            "${CMAKE_CURRENT_BINARY_DIR}/googlebenchmark"
+                     CMAKE_ARGS        "${gbenchmark_project_args}"
+                     UPDATE_COMMAND    ""   # omit update step
+                     INSTALL_COMMAND   "")  # do not install
+
+unset (gbenchmark_project_args)
+
+# The library target of Google Benchmark is wrapped in the gbenchmark_all interface. The benchmarks define their
+# own main function with BENCHMARK_MAIN(), thus the benchmark_main library is not linked.
+add_library (gbenchmark_all INTERFACE)
+ExternalProject_Get_Property (googlebenchmark binary_dir)
+foreach (target "benchmark")
+    # Import the library from the benchmark build directory.
+    add_library (${target} UNKNOWN IMPORTED)
+
+    # Define the proper target location.
+    set (target_location
+        "${binary_dir}/src/${CMAKE_FIND_LIBRARY_PREFIXES}${target}${CMAKE_STATIC_LIBRARY_SUFFIX}")
+
+    set_target_properties (${target} PROPERTIES IMPORTED_LOCATION "${target_location}")
+    # Require Google Benchmark to be downloaded before the library is created.
+    add_dependencies (${target} googlebenchmark)
+    # Add the library to the 'gbenchmark_all' interface target.
+    target_link_libraries (gbenchmark_all INTERFACE ${target})
+
+    unset (target_location)
+endforeach ()
+
+# Add the include directory to the 'gbenchmark_all' interface target.
+ExternalProject_Get_Property (googlebenchmark source_dir)
+target_include_directories (gbenchmark_all INTERFACE "${source_dir}/include")